@@ -0,0 +1,373 @@
+// Thrive Game
+// Copyright (C) 2013-2019  Revolutionary Games
+// ------------------------------------ //
+//! \file Headless benchmark of the compound cloud simulation
+//!
+//! Runs a CellStageWorld without graphics, fills the clouds according to a
+//! deterministic scenario and times the world ticks. The results are printed
+//! as one JSON object per scenario per line so that they can be collected by
+//! scripts to track regressions. Usage:
+//! ThriveBench [--scenario name|all] [--ticks count] [--warmup count]
+//! [--seed number]
+#include "ThriveGame.h"
+#include "engine/player_data.h"
+#include "generated/cell_stage_world.h"
+#include "microbe_stage/compound_cloud_system.h"
+
+#include <Entities/Components.h>
+#include <LeviathanTest/PartialEngine.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace thrive;
+
+namespace {
+
+//! The loaded clouds cover [-LOADED_HALF_SIZE, LOADED_HALF_SIZE] on both axes
+//! when the player is at the origin
+constexpr float LOADED_HALF_SIZE = CLOUD_WIDTH + CLOUD_X_EXTENT;
+
+//! The compounds that have clouds. Like in the game these make two cloud
+//! groups, one full and one with a single compound
+constexpr CompoundId BENCHMARK_COMPOUNDS = 5;
+
+//! \brief ThriveGame that can run a world without the rest of the game
+class BenchThriveGame : public ThriveGame {
+public:
+    BenchThriveGame(Leviathan::Engine* engine) : ThriveGame(engine)
+    {
+        // We need to fake key configurations for things
+        ApplicationConfiguration = new Leviathan::AppDef(true);
+        ApplicationConfiguration->ReplaceGameAndKeyConfigInMemory(
+            nullptr, &ThriveGame::CheckGameKeyConfigVariables);
+    }
+
+    ~BenchThriveGame()
+    {
+        delete ApplicationConfiguration;
+    }
+
+    bool
+        lightweightInit()
+    {
+        return createImpl();
+    }
+};
+
+//! \brief A cell stage world with only the player and the clouds in it
+class BenchmarkWorld {
+public:
+    BenchmarkWorld()
+    {
+        if(!thrive.lightweightInit())
+            throw std::runtime_error("failed to initialize the game");
+
+        world.SetRunInBackground(true);
+
+        // Without graphics the clouds are simulated but not rendered
+        if(!world.Init(
+               Leviathan::WorldNetworkSettings::GetSettingsForHybrid(),
+               nullptr))
+            throw std::runtime_error("failed to initialize the world");
+
+        player = world.CreateEntity();
+
+        thrive.playerData().setActiveCreature(player);
+
+        world.Create_Position(
+            player, Float3(0, 0, 0), Float4::IdentityQuaternion());
+
+        std::vector<Compound> cloudTypes;
+
+        for(CompoundId id = 1; id <= BENCHMARK_COMPOUNDS; ++id) {
+            cloudTypes.emplace_back(id, "benchmark" + std::to_string(id),
+                true, true, false, Float4(0, 1, 2, 3));
+        }
+
+        auto& clouds = world.GetCompoundCloudSystem();
+
+        clouds.registerCloudTypes(world, cloudTypes);
+
+        // Every tick steps every cloud group so that the per step numbers
+        // can be calculated from the tick count
+        clouds.setSimulationRate(1000.f / Leviathan::TICKSPEED);
+
+        // This spawns the clouds
+        world.Tick(1);
+    }
+
+    ~BenchmarkWorld()
+    {
+        world.Release();
+    }
+
+    //! \returns The total amount of simulated channels in all the clouds
+    size_t
+        countChannels()
+    {
+        size_t channels = 0;
+
+        for(ObjectID entity : world.GetEntities()) {
+
+            if(entity == player)
+                continue;
+
+            const auto& cloud =
+                world.GetComponent_CompoundCloudComponent(entity);
+
+            for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
+                if(cloud.getCompoundIdForChannel(i) != NULL_COMPOUND)
+                    ++channels;
+            }
+        }
+
+        return channels;
+    }
+
+    Leviathan::Test::PartialEngine<false> engine;
+    BenchThriveGame thrive{&engine};
+    Leviathan::IDFactory ids;
+
+    CellStageWorld world{nullptr};
+
+    ObjectID player = NULL_OBJECT;
+};
+
+//! \brief A way to fill the clouds
+struct Scenario {
+    const char* name;
+
+    //! Adds the compounds the scenario starts with
+    void (*start)(CompoundCloudSystem& clouds, std::mt19937& random);
+
+    //! Called before each tick. Can be null
+    void (*tick)(CompoundCloudSystem& clouds, int tick);
+};
+
+//! \returns The world position of the center of cloud cell (x, y) when the
+//! cells of all the loaded clouds are counted from the top left
+Float3
+    loadedCellPosition(size_t x, size_t y)
+{
+    return Float3(-LOADED_HALF_SIZE + (x + 0.5f) * CLOUD_RESOLUTION, 0,
+        -LOADED_HALF_SIZE + (y + 0.5f) * CLOUD_RESOLUTION);
+}
+
+//! Every cell of every channel has something in it
+void
+    startUniformField(CompoundCloudSystem& clouds, std::mt19937&)
+{
+    std::vector<CloudDeposit> deposits;
+
+    for(size_t y = 0; y < CLOUD_SIMULATION_HEIGHT * 3; ++y) {
+        for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH * 3; ++x) {
+
+            for(CompoundId id = 1; id <= BENCHMARK_COMPOUNDS; ++id)
+                deposits.push_back({id, 1000, loadedCellPosition(x, y)});
+        }
+    }
+
+    clouds.addClouds(deposits);
+}
+
+//! Large amounts in a few random places that spread out over the run
+void
+    startPointSources(CompoundCloudSystem& clouds, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(
+        -LOADED_HALF_SIZE, LOADED_HALF_SIZE);
+    std::uniform_real_distribution<float> amount(5000, 50000);
+    std::uniform_int_distribution<CompoundId> compound(1, BENCHMARK_COMPOUNDS);
+
+    std::vector<CloudDeposit> deposits;
+
+    for(int i = 0; i < 64; ++i) {
+        // Separate statements so that the order of the random numbers
+        // doesn't depend on the compiler
+        const CompoundId id = compound(random);
+        const float x = position(random);
+        const float z = position(random);
+
+        deposits.push_back({id, amount(random), Float3(x, 0, z)});
+    }
+
+    clouds.addClouds(deposits);
+}
+
+//! Nothing at the start
+void
+    startEmpty(CompoundCloudSystem&, std::mt19937&)
+{}
+
+//! Venters circling the player that vent every tick, like a crowd of cells
+//! that are all dying at once
+void
+    tickVenterStorm(CompoundCloudSystem& clouds, int tick)
+{
+    constexpr int VENTERS = 32;
+    constexpr float RADIUS = CLOUD_WIDTH;
+
+    std::vector<CloudDeposit> deposits;
+
+    for(int i = 0; i < VENTERS; ++i) {
+
+        const float angle =
+            (i + tick * 0.05f) * 2 * Leviathan::PI / VENTERS;
+
+        deposits.push_back(
+            {static_cast<CompoundId>(i % BENCHMARK_COMPOUNDS + 1), 500,
+                Float3(std::cos(angle) * RADIUS * (1 + i % 2), 0,
+                    std::sin(angle) * RADIUS * (1 + i % 2))});
+    }
+
+    clouds.addClouds(deposits);
+}
+
+const Scenario SCENARIOS[] = {
+    {"uniform", startUniformField, nullptr},
+    {"point_sources", startPointSources, nullptr},
+    {"venter_storm", startEmpty, tickVenterStorm},
+};
+
+struct BenchmarkOptions {
+    std::string scenario = "all";
+    int ticks = 200;
+    int warmupTicks = 20;
+    uint32_t seed = 1;
+};
+
+void
+    runScenario(const Scenario& scenario, const BenchmarkOptions& options)
+{
+    BenchmarkWorld bench;
+
+    auto& clouds = bench.world.GetCompoundCloudSystem();
+
+    std::mt19937 random(options.seed);
+    scenario.start(clouds, random);
+
+    // The world tick 1 was used to spawn the clouds
+    int tick = 2;
+
+    for(int i = 0; i < options.warmupTicks; ++i, ++tick) {
+        if(scenario.tick)
+            scenario.tick(clouds, tick);
+
+        bench.world.Tick(tick);
+    }
+
+    const uint64_t droppedBefore = clouds.getDroppedSimulationSteps();
+
+    std::chrono::nanoseconds total{0};
+
+    for(int i = 0; i < options.ticks; ++i, ++tick) {
+        // The deposits aren't part of the measured time
+        if(scenario.tick)
+            scenario.tick(clouds, tick);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        bench.world.Tick(tick);
+
+        total += std::chrono::steady_clock::now() - start;
+    }
+
+    const size_t channels = bench.countChannels();
+    const double nanoseconds = static_cast<double>(total.count());
+    const double channelSteps = static_cast<double>(channels) * options.ticks;
+    const double cellSteps =
+        channelSteps * CLOUD_SIMULATION_WIDTH * CLOUD_SIMULATION_HEIGHT;
+
+    std::cout << "{\"scenario\": \"" << scenario.name << "\""
+              << ", \"ticks\": " << options.ticks
+              << ", \"seed\": " << options.seed
+              << ", \"channels\": " << channels
+              << ", \"cells_per_channel\": "
+              << CLOUD_SIMULATION_WIDTH * CLOUD_SIMULATION_HEIGHT
+              << ", \"ns_per_tick\": " << nanoseconds / options.ticks
+              << ", \"ns_per_channel\": " << nanoseconds / channelSteps
+              << ", \"ns_per_cell\": " << nanoseconds / cellSteps
+              << ", \"dropped_steps\": "
+              << clouds.getDroppedSimulationSteps() - droppedBefore << "}"
+              << std::endl;
+}
+
+bool
+    parseOptions(int argc, char* argv[], BenchmarkOptions& options)
+{
+    for(int i = 1; i < argc; ++i) {
+
+        if(i + 1 >= argc) {
+            std::cerr << "missing value for " << argv[i] << "\n";
+            return false;
+        }
+
+        const char* value = argv[++i];
+
+        if(std::strcmp(argv[i - 1], "--scenario") == 0) {
+            options.scenario = value;
+        } else if(std::strcmp(argv[i - 1], "--ticks") == 0) {
+            options.ticks = std::stoi(value);
+        } else if(std::strcmp(argv[i - 1], "--warmup") == 0) {
+            options.warmupTicks = std::stoi(value);
+        } else if(std::strcmp(argv[i - 1], "--seed") == 0) {
+            options.seed = static_cast<uint32_t>(std::stoul(value));
+        } else {
+            std::cerr << "unknown option " << argv[i - 1] << "\n";
+            return false;
+        }
+    }
+
+    if(options.ticks <= 0 || options.warmupTicks < 0) {
+        std::cerr << "the tick counts can't be negative\n";
+        return false;
+    }
+
+    return true;
+}
+} // namespace
+
+int
+    main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+
+    try {
+        if(!parseOptions(argc, argv, options))
+            return 2;
+    } catch(const std::logic_error&) {
+        std::cerr << "invalid number in the options\n";
+        return 2;
+    }
+
+    bool found = false;
+
+    for(const Scenario& scenario : SCENARIOS) {
+
+        if(options.scenario != "all" && options.scenario != scenario.name)
+            continue;
+
+        found = true;
+
+        try {
+            runScenario(scenario, options);
+        } catch(const std::exception& e) {
+            std::cerr << scenario.name << " failed: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if(!found) {
+        std::cerr << "unknown scenario " << options.scenario << "\n";
+        return 2;
+    }
+
+    return 0;
+}
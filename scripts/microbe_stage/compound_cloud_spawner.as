@@ -19,11 +19,23 @@ void createCompoundCloud(CellStageWorld@ world, CompoundId compound,
 void spawnCompoundCloud(CellStageWorld@ world, CompoundId compound, float amount,
     const Float3 &in pos)
 {
-    createCompoundCloud(world, compound, pos.X+2, pos.Z, amount);
-    createCompoundCloud(world, compound, pos.X-2, pos.Z, amount);
-    createCompoundCloud(world, compound, pos.X, pos.Z+2, amount);
-    createCompoundCloud(world, compound, pos.X, pos.Z-2, amount);
-    createCompoundCloud(world, compound, pos.X, pos.Z, amount);
+    if(amount <= 0){
+        LOG_ERROR("spawnCompoundCloud amount is <= 0");
+        return;
+    }
+
+    // All the points are placed with one call
+    array<CompoundId> compounds = {compound, compound, compound, compound, compound};
+    array<float> amounts = {amount, amount, amount, amount, amount};
+    array<Float3> positions = {
+        Float3(pos.X+2, 0, pos.Z),
+        Float3(pos.X-2, 0, pos.Z),
+        Float3(pos.X, 0, pos.Z+2),
+        Float3(pos.X, 0, pos.Z-2),
+        Float3(pos.X, 0, pos.Z)
+    };
+
+    world.GetCompoundCloudSystem().addClouds(compounds, amounts, positions);
 }
 
 
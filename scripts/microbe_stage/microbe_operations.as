@@ -449,16 +449,8 @@ double takeCompound(MicrobeComponent@ microbeComponent, CompoundBagComponent@ co
     return takenAmount;
 }
 
-// Ejects compounds from the microbes behind position, into the enviroment
-// Note that the compounds ejected are created in this world and not taken from the microbe
-//
-// @param compoundId
-// The compound type to create and eject
-//
-// @param amount
-// The amount to eject
-void ejectCompound(CellStageWorld@ world, ObjectID microbeEntity, CompoundId compoundId,
-    double amount)
+// Returns the point behind the microbe where compounds are ejected
+Float3 getEjectionPosition(CellStageWorld@ world, ObjectID microbeEntity)
 {
     MicrobeComponent@ microbeComponent = cast<MicrobeComponent>(
         world.GetScriptComponentHolder("MicrobeComponent").Find(microbeEntity));
@@ -504,16 +496,42 @@ void ejectCompound(CellStageWorld@ world, ObjectID microbeEntity, CompoundId com
     auto xnew = -membraneCoords.X * c + membraneCoords.Y * s;
     auto ynew = membraneCoords.X * s + membraneCoords.Y * c;
 
+    return Float3(position._Position.X + xnew * ejectionDistance, 0,
+        position._Position.Z + ynew * ejectionDistance);
+}
+
+// Ejects compounds from the microbes behind position, into the enviroment
+// Note that the compounds ejected are created in this world and not taken from the microbe
+//
+// @param compoundId
+// The compound type to create and eject
+//
+// @param amount
+// The amount to eject
+void ejectCompound(CellStageWorld@ world, ObjectID microbeEntity, CompoundId compoundId,
+    double amount)
+{
     auto amountToEject = amount*10000;
 
     if(amountToEject > 0){
-        createCompoundCloud(world, uint64(compoundId),
-            position._Position.X + xnew * ejectionDistance,
-            position._Position.Z + ynew * ejectionDistance,
+        auto exit = getEjectionPosition(world, microbeEntity);
+        createCompoundCloud(world, uint64(compoundId), exit.X, exit.Z,
             amountToEject);
     }
 }
 
+// Adds an ejected amount to the arrays that purgeCompounds passes to addClouds
+void addEjectedCompound(array<CompoundId>@ compounds, array<float>@ amounts,
+    CompoundId compoundId, double amount)
+{
+    auto amountToEject = amount*10000;
+
+    if(amountToEject > 0){
+        compounds.insertLast(compoundId);
+        amounts.insertLast(float(amountToEject));
+    }
+}
+
 // Default version of purgeCompounds that takes ObjectID
 void purgeCompounds(CellStageWorld@ world, ObjectID microbeEntity)
 {
@@ -531,6 +549,11 @@ void purgeCompounds(CellStageWorld@ world, ObjectID microbeEntity,
     MicrobeComponent@ microbeComponent, CompoundBagComponent@ compoundBag)
 {
     uint64 compoundCount = SimulationParameters::compoundRegistry().getSize();
+
+    // Everything is ejected at the same point so it can be added with one call
+    array<CompoundId> compounds;
+    array<float> amounts;
+
     for(uint compoundId = 0; compoundId < compoundCount; ++compoundId){
 
         // Price is 1 if used, 0 if not
@@ -551,14 +574,14 @@ void purgeCompounds(CellStageWorld@ world, ObjectID microbeEntity,
             if(amountToEject > 0.0f && availableCompound-amountToEject >= 0.0f){
                 amountToEject = takeCompound(microbeComponent, compoundBag,
                     compoundId, amountToEject);
-                ejectCompound(world, microbeEntity, compoundId, amountToEject-1.0f);
+                addEjectedCompound(compounds, amounts, compoundId, amountToEject-1.0f);
             }
             // If we flagged the second one but we still have some left just get rid of it all
             else if (availableCompound > 0.0f)
             {
                 amountToEject = takeCompound(microbeComponent, compoundBag,
                     compoundId, availableCompound);
-                ejectCompound(world, microbeEntity, compoundId, amountToEject-1.0f);
+                addEjectedCompound(compounds, amounts, compoundId, amountToEject-1.0f);
             }
         }
         //Empty when you have too many compounds even when its useful
@@ -566,9 +589,19 @@ void purgeCompounds(CellStageWorld@ world, ObjectID microbeEntity,
         if(availableCompound > microbeComponent.capacity){
                 double amountToEject = takeCompound(microbeComponent, compoundBag,
                     compoundId, availableCompound-microbeComponent.capacity);
-                ejectCompound(world, microbeEntity, compoundId, amountToEject-1.0f);
+                addEjectedCompound(compounds, amounts, compoundId, amountToEject-1.0f);
             }
     }
+
+    if(compounds.length() == 0)
+        return;
+
+    auto exit = getEjectionPosition(world, microbeEntity);
+    array<Float3> positions;
+    for(uint i = 0; i < compounds.length(); ++i)
+        positions.insertLast(exit);
+
+    world.GetCompoundCloudSystem().addClouds(compounds, amounts, positions);
 }
 
 // Rebuilds the list of processes a cell does. Needs to be called
@@ -36,30 +36,33 @@ PerlinNoise::PerlinNoise()
         181, 199, 106, 157, 184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150,
         254, 138, 236, 205, 93, 222, 114, 67, 29, 24, 72, 243, 141, 128, 195,
         78, 66, 215, 61, 156, 180};
-    // Duplicate the permutation vector
-    p.insert(p.end(), p.begin(), p.end());
+    duplicatePermutation();
 }
 
 // Generate a new permutation vector based on the value of seed
 PerlinNoise::PerlinNoise(unsigned int seed)
 {
-    p.resize(256);
-
     // Fill p with values from 0 to 255
-    std::iota(p.begin(), p.end(), 0);
+    std::iota(p.begin(), p.begin() + 256, 0);
 
     // Initialize a random engine with seed
     std::default_random_engine engine(seed);
 
     // Suffle  using the above random engine
-    std::shuffle(p.begin(), p.end(), engine);
+    std::shuffle(p.begin(), p.begin() + 256, engine);
+
+    duplicatePermutation();
+}
 
-    // Duplicate the permutation vector
-    p.insert(p.end(), p.begin(), p.end());
+// Duplicate the permutation vector
+void
+    PerlinNoise::duplicatePermutation()
+{
+    std::copy(p.begin(), p.begin() + 256, p.begin() + 256);
 }
 
 double
-    PerlinNoise::noise(double x, double y, double z)
+    PerlinNoise::noise(double x, double y, double z) const
 {
     // Find the unit cube that contains the point
     int X = static_cast<int>(floor(x)) & 255;
@@ -96,23 +99,152 @@ double
     return (res + 1.0) / 2.0;
 }
 
-double
-    PerlinNoise::fade(double t)
+float
+    PerlinNoise::noisef(float x, float y, float z) const
+{
+    // Same as noise but without the conversions to double
+    const float floorX = std::floor(x);
+    const float floorY = std::floor(y);
+    const float floorZ = std::floor(z);
+
+    int X = static_cast<int>(floorX) & 255;
+    int Y = static_cast<int>(floorY) & 255;
+    int Z = static_cast<int>(floorZ) & 255;
+
+    x -= floorX;
+    y -= floorY;
+    z -= floorZ;
+
+    float u = fade(x);
+    float v = fade(y);
+    float w = fade(z);
+
+    int A = p[X] + Y;
+    int AA = p[A] + Z;
+    int AB = p[A + 1] + Z;
+    int B = p[X + 1] + Y;
+    int BA = p[B] + Z;
+    int BB = p[B + 1] + Z;
+
+    float res = lerp(w,
+        lerp(v, lerp(u, grad(p[AA], x, y, z), grad(p[BA], x - 1, y, z)),
+            lerp(u, grad(p[AB], x, y - 1, z), grad(p[BB], x - 1, y - 1, z))),
+        lerp(v,
+            lerp(u, grad(p[AA + 1], x, y, z - 1),
+                grad(p[BA + 1], x - 1, y, z - 1)),
+            lerp(u, grad(p[AB + 1], x, y - 1, z - 1),
+                grad(p[BB + 1], x - 1, y - 1, z - 1))));
+    return (res + 1.0f) / 2.0f;
+}
+
+void
+    PerlinNoise::noiseRow(float xStart,
+        float xStep,
+        float y,
+        float z,
+        float* out,
+        size_t count) const
+{
+    // The cube walking below needs to move forward
+    if(xStep <= 0) {
+        for(size_t i = 0; i < count; ++i)
+            out[i] = noisef(xStart + i * xStep, y, z);
+        return;
+    }
+
+    // y and z are the same for the whole row
+    const float floorY = std::floor(y);
+    const float floorZ = std::floor(z);
+
+    const int Y = static_cast<int>(floorY) & 255;
+    const int Z = static_cast<int>(floorZ) & 255;
+
+    y -= floorY;
+    z -= floorZ;
+
+    const float v = fade(y);
+    const float w = fade(z);
+
+    size_t i = 0;
+
+    while(i < count) {
+
+        const float floorX = std::floor(xStart + i * xStep);
+        const int X = static_cast<int>(floorX) & 255;
+
+        const int A = p[X] + Y;
+        const int AA = p[A] + Z;
+        const int AB = p[A + 1] + Z;
+        const int B = p[X + 1] + Y;
+        const int BA = p[B] + Z;
+        const int BB = p[B + 1] + Z;
+
+        // Inside one cube only x changes and grad is linear in x. So the y
+        // and z interpolations can be done once here for the gradient slope
+        // along x and the rest of the gradient separately. The left face
+        // (x = 0) is then slope0 * x + offset0 and the right face (x = 1) is
+        // slope1 * (x - 1) + offset1
+        const float slope0 = lerp(w,
+            lerp(v, grad(p[AA], 1.f, 0.f, 0.f), grad(p[AB], 1.f, 0.f, 0.f)),
+            lerp(v, grad(p[AA + 1], 1.f, 0.f, 0.f),
+                grad(p[AB + 1], 1.f, 0.f, 0.f)));
+        const float offset0 = lerp(w,
+            lerp(v, grad(p[AA], 0.f, y, z), grad(p[AB], 0.f, y - 1, z)),
+            lerp(v, grad(p[AA + 1], 0.f, y, z - 1),
+                grad(p[AB + 1], 0.f, y - 1, z - 1)));
+
+        const float slope1 = lerp(w,
+            lerp(v, grad(p[BA], 1.f, 0.f, 0.f), grad(p[BB], 1.f, 0.f, 0.f)),
+            lerp(v, grad(p[BA + 1], 1.f, 0.f, 0.f),
+                grad(p[BB + 1], 1.f, 0.f, 0.f)));
+        const float offset1 = lerp(w,
+            lerp(v, grad(p[BA], 0.f, y, z), grad(p[BB], 0.f, y - 1, z)),
+            lerp(v, grad(p[BA + 1], 0.f, y, z - 1),
+                grad(p[BB + 1], 0.f, y - 1, z - 1)));
+
+        // The points that are inside this cube. At least one is always taken
+        // so that rounding can't cause an infinite loop. A point that rounds
+        // just outside the cube is still continuous with the neighbour
+        const float cubeEnd = std::ceil((floorX + 1 - xStart) / xStep);
+
+        const size_t end = std::clamp(
+            cubeEnd > 0 ? static_cast<size_t>(cubeEnd) : 0, i + 1, count);
+
+        for(size_t j = i; j < end; ++j) {
+
+            const float x = xStart + j * xStep - floorX;
+            const float u = fade(x);
+
+            const float left = slope0 * x + offset0;
+            const float right = slope1 * (x - 1) + offset1;
+
+            out[j] = (lerp(u, left, right) + 1.0f) / 2.0f;
+        }
+
+        i = end;
+    }
+}
+
+template<typename T>
+T
+    PerlinNoise::fade(T t)
 {
     return t * t * t * (t * (t * 6 - 15) + 10);
 }
 
-double
-    PerlinNoise::lerp(double t, double a, double b)
+template<typename T>
+T
+    PerlinNoise::lerp(T t, T a, T b)
 {
     return a + t * (b - a);
 }
 
-double
-    PerlinNoise::grad(int hash, double x, double y, double z)
+template<typename T>
+T
+    PerlinNoise::grad(int hash, T x, T y, T z)
 {
     int h = hash & 15;
     // Convert lower 4 bits of hash inot 12 gradient directions
-    double u = h < 8 ? x : y, v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+    T u = h < 8 ? x : y, v = h < 4 ? y : h == 12 || h == 14 ? x : z;
     return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 }
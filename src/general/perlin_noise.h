@@ -1,4 +1,6 @@
-#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 
 // This class is borrowed from the guy below, as long as we don't take credit
 // and modify it, we're allowed to use it. This code is under GPL v3 Copyright
@@ -15,8 +17,9 @@
 #pragma once
 
 class PerlinNoise {
-    // The permutation vector
-    std::vector<int> p;
+    // The permutation table, duplicated so that the indices don't need to be
+    // wrapped
+    std::array<uint8_t, 512> p;
 
 public:
     // Initialize with the reference values for the permutation vector
@@ -25,13 +28,37 @@ public:
     PerlinNoise(unsigned int seed);
     // Get a noise value, for 2D images z can have any value
     double
-        noise(double x, double y, double z);
+        noise(double x, double y, double z) const;
+
+    // Single precision version of noise. The result is the same within float
+    // rounding error
+    float
+        noisef(float x, float y, float z) const;
+
+    // Evaluates noisef(xStart + i * xStep, y, z) for all i in [0, count) and
+    // writes the results to out. This is a lot faster than calling noisef
+    // in a loop as the lattice hashing is only done once per unit cube and
+    // the points inside one cube are a simple loop that the compiler can
+    // vectorize
+    void
+        noiseRow(float xStart,
+            float xStep,
+            float y,
+            float z,
+            float* out,
+            size_t count) const;
 
 private:
-    double
-        fade(double t);
-    double
-        lerp(double t, double a, double b);
-    double
-        grad(int hash, double x, double y, double z);
+    template<typename T>
+    static T
+        fade(T t);
+    template<typename T>
+    static T
+        lerp(T t, T a, T b);
+    template<typename T>
+    static T
+        grad(int hash, T x, T y, T z);
+
+    void
+        duplicatePermutation();
 };
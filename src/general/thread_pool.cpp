@@ -0,0 +1,170 @@
+// ------------------------------------ //
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+using namespace thrive;
+
+namespace {
+//! \brief Shared between the threads running one parallelFor
+//!
+//! This is reference counted so that helper tasks that only start after the
+//! loop has ended (because the workers were busy) can still safely look at it
+struct ParallelForState {
+    ParallelForState(size_t count, const std::function<void(size_t)>& body) :
+        count(count), body(body)
+    {}
+
+    std::atomic<size_t> next = {0};
+    const size_t count;
+
+    //! Only dereferenced when there are iterations left, which means the
+    //! calling parallelFor is still waiting
+    const std::function<void(size_t)>& body;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t completed = 0;
+    std::exception_ptr error;
+};
+
+void
+    runParallelForIterations(ParallelForState& state)
+{
+    size_t ranHere = 0;
+
+    for(size_t i = state.next++; i < state.count; i = state.next++) {
+        try {
+            state.body(i);
+        } catch(...) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if(!state.error)
+                state.error = std::current_exception();
+        }
+
+        ++ranHere;
+    }
+
+    if(ranHere == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.completed += ranHere;
+
+    if(state.completed == state.count)
+        state.finished.notify_all();
+}
+} // namespace
+
+// ------------------------------------ //
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    m_threads.reserve(threadCount);
+
+    for(size_t i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&ThreadPool::_runWorker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+
+    m_notifyWorkers.notify_all();
+
+    for(auto& thread : m_threads)
+        thread.join();
+}
+// ------------------------------------ //
+void
+    ThreadPool::parallelFor(size_t count,
+        const std::function<void(size_t)>& body)
+{
+    if(count == 0)
+        return;
+
+    // Not worth waking up anyone
+    if(m_threads.empty() || count == 1) {
+        for(size_t i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>(count, body);
+
+    const auto helpers = std::min(m_threads.size(), count - 1);
+
+    for(size_t i = 0; i < helpers; ++i)
+        _enqueue([state]() { runParallelForIterations(*state); });
+
+    runParallelForIterations(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(
+        lock, [&state]() { return state->completed == state->count; });
+
+    if(state->error)
+        std::rethrow_exception(state->error);
+}
+// ------------------------------------ //
+void
+    ThreadPool::_enqueue(std::function<void()> task)
+{
+    if(m_threads.empty()) {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue.push_back(std::move(task));
+    }
+
+    m_notifyWorkers.notify_one();
+}
+
+void
+    ThreadPool::_runWorker()
+{
+    while(true) {
+
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_notifyWorkers.wait(
+                lock, [this]() { return m_stop || !m_queue.empty(); });
+
+            if(m_stop)
+                return;
+
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        task();
+    }
+}
+// ------------------------------------ //
+size_t
+    ThreadPool::getDefaultThreadCount()
+{
+    const auto cores = std::thread::hardware_concurrency();
+
+    if(cores <= 1)
+        return 0;
+
+    return cores - 1;
+}
+
+ThreadPool&
+    ThreadPool::getShared()
+{
+    static ThreadPool pool(getDefaultThreadCount());
+    return pool;
+}
@@ -0,0 +1,94 @@
+#pragma once
+// Thrive Game
+// Copyright (C) 2013-2019  Revolutionary Games
+// ------------------------------------ //
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace thrive {
+
+//! \brief Simple pool of worker threads for splitting up simulation work
+//!
+//! This is used instead of the Leviathan tasks for work that needs to be done
+//! inside a single tick (parallelFor) and background work that the main thread
+//! polls for (submit)
+class ThreadPool {
+public:
+    //! \param threadCount How many worker threads to start. 0 is allowed in
+    //! which case everything runs on the calling thread
+    explicit ThreadPool(size_t threadCount);
+
+    //! \brief Waits for the currently running tasks and stops the threads.
+    //! Tasks that haven't started are discarded
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool&
+        operator=(const ThreadPool&) = delete;
+
+    //! \brief Runs body(i) for all i in [0, count) and returns once all are
+    //! done
+    //!
+    //! The calling thread also runs iterations so this can be used even if the
+    //! workers are busy. The iterations may run in any order, so body must not
+    //! depend on other iterations. If any iteration throws the first exception
+    //! is rethrown here after all the iterations have finished.
+    void
+        parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    //! \brief Queues a task to run on a worker thread
+    //! \returns A future for the result of the task
+    //! \note If there are no worker threads the task is ran immediately
+    template<class F>
+    auto
+        submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using ResultT = std::invoke_result_t<std::decay_t<F>>;
+
+        auto packaged = std::make_shared<std::packaged_task<ResultT()>>(
+            std::forward<F>(task));
+
+        auto future = packaged->get_future();
+
+        _enqueue([packaged]() { (*packaged)(); });
+        return future;
+    }
+
+    size_t
+        getThreadCount() const
+    {
+        return m_threads.size();
+    }
+
+    //! \returns The worker count to use to leave one core for the main thread
+    static size_t
+        getDefaultThreadCount();
+
+    //! \brief Process wide pool used by the simulation systems
+    static ThreadPool&
+        getShared();
+
+private:
+    void
+        _enqueue(std::function<void()> task);
+
+    void
+        _runWorker();
+
+private:
+    std::mutex m_queueMutex;
+    std::condition_variable m_notifyWorkers;
+    std::deque<std::function<void()>> m_queue;
+    bool m_stop = false;
+
+    std::vector<std::thread> m_threads;
+};
+
+} // namespace thrive
@@ -0,0 +1,547 @@
+#pragma once
+// Thrive Game
+// Copyright (C) 2013-2019  Revolutionary Games
+// ------------------------------------ //
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace thrive {
+
+//! \brief How the channels of a cloud are packed into CloudDensityStorage
+enum class CLOUD_CHANNEL_LAYOUT {
+    //! Each channel is its own contiguous width * height plane. This is the
+    //! layout the simulation kernels are fastest with
+    PLANAR,
+
+    //! All the channels of one cell are next to each other (like the RGBA
+    //! texture the clouds are uploaded into)
+    INTERLEAVED
+};
+
+//! The layout all clouds use. This is a compile time choice so that the
+//! accessors don't need to branch
+constexpr auto CLOUD_DENSITY_LAYOUT = CLOUD_CHANNEL_LAYOUT::PLANAR;
+
+//! How many compound channels are stored in one cloud
+constexpr size_t CLOUD_DENSITY_CHANNELS = 4;
+
+//! \brief Converts a non-negative float to a half float
+//!
+//! Values too small to be a normal half float (and negative values) become 0
+//! and too large ones are clamped to the largest half float. The rounding
+//! error is at most 2^-11 of the value
+inline uint16_t
+    floatToHalf(float value)
+{
+    // This is also false for NaN
+    if(!(value >= 6.103515625e-05f))
+        return 0;
+
+    if(value >= 65504.f)
+        return 0x7bff;
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    // Rounds the mantissa and moves the exponent to the half float bias
+    return static_cast<uint16_t>(((bits + 0x1000) >> 13) - (112 << 10));
+}
+
+//! \brief Inverse of floatToHalf. Only handles what floatToHalf returns
+inline float
+    halfToFloat(uint16_t half)
+{
+    if(half == 0)
+        return 0;
+
+    const uint32_t bits = (static_cast<uint32_t>(half) << 13) + (112 << 23);
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//! \brief A cloud density stored in 16 bits
+//!
+//! This is a half float of the density divided by SCALE so that it covers
+//! the range of densities the clouds have. Converts to and from float
+//! implicitly so the kernels work with this the same as with floats.
+//!
+//! Error bound: each stored value is within 2^-11 (about 0.05%) of the
+//! written float. Values below MIN_VALUE become 0, these are well below
+//! CLOUD_EMPTY_THRESHOLD. Values above MAX_VALUE are clamped. As the
+//! rounding goes to the nearest value the errors mostly cancel out, so the
+//! total amount of a compound drifts much less than the per cell bound
+class CloudDensityHalf {
+public:
+    static constexpr float SCALE = 16.f;
+    static constexpr float MIN_VALUE = 6.103515625e-05f * SCALE;
+    static constexpr float MAX_VALUE = 65504.f * SCALE;
+
+    CloudDensityHalf() = default;
+
+    CloudDensityHalf(float value) : m_bits(floatToHalf(value / SCALE)) {}
+
+    inline operator float() const
+    {
+        return halfToFloat(m_bits) * SCALE;
+    }
+
+    inline CloudDensityHalf&
+        operator=(float value)
+    {
+        m_bits = floatToHalf(value / SCALE);
+        return *this;
+    }
+
+    inline CloudDensityHalf&
+        operator+=(float value)
+    {
+        return *this = static_cast<float>(*this) + value;
+    }
+
+    inline CloudDensityHalf&
+        operator-=(float value)
+    {
+        return *this = static_cast<float>(*this) - value;
+    }
+
+private:
+    uint16_t m_bits;
+};
+
+static_assert(sizeof(CloudDensityHalf) == 2 &&
+                  std::is_trivially_copyable_v<CloudDensityHalf>,
+    "CloudDensityHalf needs to be usable as raw memory");
+
+//! \brief What the cloud densities are stored as
+//!
+//! Halving the memory use (and the memory traffic in the simulation) is
+//! a compile time choice for the same reason as CLOUD_DENSITY_LAYOUT. Set
+//! with the HALF_CLOUD_DENSITIES CMake option
+#ifdef THRIVE_HALF_CLOUD_DENSITIES
+using CloudDensityValue = CloudDensityHalf;
+#else
+using CloudDensityValue = float;
+#endif // THRIVE_HALF_CLOUD_DENSITIES
+
+//! Alignment of the density buffer. 64 is a cache line and enough for AVX
+constexpr size_t CLOUD_DENSITY_ALIGNMENT = 64;
+
+//! \brief Rectangle of cloud cells, the end coordinates are exclusive
+//!
+//! Used to track which part of a cloud channel can have something in it so
+//! that the rest can be skipped
+struct CloudRegion {
+    size_t startX = 0;
+    size_t startY = 0;
+    size_t endX = 0;
+    size_t endY = 0;
+
+    inline bool
+        isEmpty() const
+    {
+        return startX >= endX || startY >= endY;
+    }
+
+    //! \brief Grows this to contain the cell at x, y
+    inline void
+        include(size_t x, size_t y)
+    {
+        if(isEmpty()) {
+            *this = {x, y, x + 1, y + 1};
+            return;
+        }
+
+        startX = std::min(startX, x);
+        startY = std::min(startY, y);
+        endX = std::max(endX, x + 1);
+        endY = std::max(endY, y + 1);
+    }
+
+    //! \brief Grows this to contain other
+    inline void
+        include(const CloudRegion& other)
+    {
+        if(other.isEmpty())
+            return;
+
+        if(isEmpty()) {
+            *this = other;
+            return;
+        }
+
+        startX = std::min(startX, other.startX);
+        startY = std::min(startY, other.startY);
+        endX = std::max(endX, other.endX);
+        endY = std::max(endY, other.endY);
+    }
+
+    //! \returns This grown by amount cells in every direction but limited to
+    //! a width * height grid. An empty region stays empty
+    inline CloudRegion
+        expanded(size_t amount, size_t width, size_t height) const
+    {
+        if(isEmpty())
+            return *this;
+
+        return {startX > amount ? startX - amount : 0,
+            startY > amount ? startY - amount : 0,
+            std::min(endX + amount, width), std::min(endY + amount, height)};
+    }
+
+    //! \returns The part of this that is also in other
+    inline CloudRegion
+        intersected(const CloudRegion& other) const
+    {
+        return {std::max(startX, other.startX), std::max(startY, other.startY),
+            std::min(endX, other.endX), std::min(endY, other.endY)};
+    }
+
+    inline bool
+        operator==(const CloudRegion& other) const
+    {
+        return startX == other.startX && startY == other.startY &&
+               endX == other.endX && endY == other.endY;
+    }
+};
+
+//! \brief Strided accessor for one channel in a CloudDensityStorage
+//!
+//! This is a non-owning view, copying it is cheap. Indexing is done with
+//! (x, y) where consecutive x values are next to each other in memory (taking
+//! ELEMENT_STRIDE into account)
+template<class T>
+class BasicCloudDensityView {
+public:
+    //! Distance between two horizontally adjacent cells in elements
+    static constexpr size_t ELEMENT_STRIDE =
+        CLOUD_DENSITY_LAYOUT == CLOUD_CHANNEL_LAYOUT::PLANAR ?
+            1 :
+            CLOUD_DENSITY_CHANNELS;
+
+    BasicCloudDensityView(T* data, size_t width, size_t height) :
+        m_data(data), m_width(width), m_height(height), m_pitch(width)
+    {}
+
+    //! \param pitch The distance between rows in cells. This is larger than
+    //! width for views that don't include the halo of a cloud
+    BasicCloudDensityView(T* data, size_t width, size_t height, size_t pitch) :
+        m_data(data), m_width(width), m_height(height), m_pitch(pitch)
+    {}
+
+    //! Allows converting a writable view into a read only one
+    template<class OtherT,
+        class = std::enable_if_t<std::is_same_v<const OtherT, T>>>
+    BasicCloudDensityView(const BasicCloudDensityView<OtherT>& other) :
+        m_data(other.data()), m_width(other.getWidth()),
+        m_height(other.getHeight()),
+        m_pitch(other.getRowPitch() / ELEMENT_STRIDE)
+    {}
+
+    inline T&
+        operator()(size_t x, size_t y) const
+    {
+        return m_data[(y * m_pitch + x) * ELEMENT_STRIDE];
+    }
+
+    //! \returns Pointer to the first cell of a row
+    inline T*
+        row(size_t y) const
+    {
+        return m_data + y * getRowPitch();
+    }
+
+    //! \returns The distance between two rows in elements
+    inline size_t
+        getRowPitch() const
+    {
+        return m_pitch * ELEMENT_STRIDE;
+    }
+
+    inline T*
+        data() const
+    {
+        return m_data;
+    }
+
+    inline size_t
+        getWidth() const
+    {
+        return m_width;
+    }
+
+    inline size_t
+        getHeight() const
+    {
+        return m_height;
+    }
+
+    //! \brief Sets all cells of this channel to 0
+    void
+        clear() const
+    {
+        static_assert(!std::is_const_v<T>, "can't clear a read only view");
+
+        clear(CloudRegion{0, 0, m_width, m_height});
+    }
+
+    //! \brief Sets the cells in region to 0
+    void
+        clear(const CloudRegion& region) const
+    {
+        static_assert(!std::is_const_v<T>, "can't clear a read only view");
+
+        for(size_t y = region.startY; y < region.endY; ++y) {
+            if constexpr(ELEMENT_STRIDE == 1) {
+                std::memset(row(y) + region.startX, 0,
+                    sizeof(T) * (region.endX - region.startX));
+            } else {
+                for(size_t x = region.startX; x < region.endX; ++x)
+                    (*this)(x, y) = 0;
+            }
+        }
+    }
+
+private:
+    T* m_data;
+    size_t m_width;
+    size_t m_height;
+    size_t m_pitch;
+};
+
+using CloudDensityView = BasicCloudDensityView<CloudDensityValue>;
+using ConstCloudDensityView = BasicCloudDensityView<const CloudDensityValue>;
+
+//! \brief Holds all the density data of one cloud in a single aligned buffer
+//!
+//! The buffer has two blocks: the current densities and the densities from
+//! the last simulation step. Each block has CLOUD_DENSITY_CHANNELS channels
+//! laid out according to CLOUD_DENSITY_LAYOUT.
+//!
+//! Each channel can have a halo of extra cells around it. The halo isn't part
+//! of the cloud, it is used to move compounds to and from the neighbouring
+//! clouds. getDensity and getOldDensity don't include the halo and the padded
+//! versions do. The padded coordinates are the normal ones + getHalo()
+class CloudDensityStorage {
+    struct AlignedDeleter {
+        void
+            operator()(CloudDensityValue* data) const
+        {
+            ::operator delete[](
+                data, std::align_val_t(CLOUD_DENSITY_ALIGNMENT));
+        }
+    };
+
+public:
+    //! \brief Allocates the buffer for width * height cells and zeroes it
+    //!
+    //! Calling this again with the same size only clears the data
+    //! \param halo How many extra cells there are on each side
+    void
+        allocate(size_t width, size_t height, size_t halo = 0)
+    {
+        if(!m_buffer || width != m_width || height != m_height ||
+            halo != m_halo) {
+
+            m_width = width;
+            m_height = height;
+            m_halo = halo;
+            m_buffer.reset(static_cast<CloudDensityValue*>(::operator new[](
+                getTotalBytes(), std::align_val_t(CLOUD_DENSITY_ALIGNMENT))));
+        }
+
+        clear();
+    }
+
+    //! \brief Zeroes all channels (both current and old)
+    void
+        clear()
+    {
+        if(m_buffer)
+            std::memset(m_buffer.get(), 0, getTotalBytes());
+
+        m_activeRegions.fill(CloudRegion());
+    }
+
+    //! \brief The cells of a channel that can be non-zero, in padded
+    //! coordinates
+    //!
+    //! Everything outside this is 0 in the current densities. The old
+    //! densities are only scratch space for the simulation steps. The region
+    //! may be larger than what actually has something in it. Anything
+    //! writing into the density needs to keep this up to date
+    inline CloudRegion&
+        getActiveRegion(size_t channel)
+    {
+        return m_activeRegions[channel];
+    }
+
+    inline const CloudRegion&
+        getActiveRegion(size_t channel) const
+    {
+        return m_activeRegions[channel];
+    }
+
+    inline bool
+        isAllocated() const
+    {
+        return m_buffer != nullptr;
+    }
+
+    inline CloudDensityView
+        getDensity(size_t channel)
+    {
+        return interiorView<CloudDensityValue>(channelStart(0, channel));
+    }
+
+    inline ConstCloudDensityView
+        getDensity(size_t channel) const
+    {
+        return interiorView<const CloudDensityValue>(channelStart(0, channel));
+    }
+
+    inline CloudDensityView
+        getOldDensity(size_t channel)
+    {
+        return interiorView<CloudDensityValue>(channelStart(1, channel));
+    }
+
+    inline ConstCloudDensityView
+        getOldDensity(size_t channel) const
+    {
+        return interiorView<const CloudDensityValue>(channelStart(1, channel));
+    }
+
+    inline CloudDensityView
+        getPaddedDensity(size_t channel)
+    {
+        return CloudDensityView(
+            channelStart(0, channel), getPaddedWidth(), getPaddedHeight());
+    }
+
+    inline ConstCloudDensityView
+        getPaddedDensity(size_t channel) const
+    {
+        return ConstCloudDensityView(
+            channelStart(0, channel), getPaddedWidth(), getPaddedHeight());
+    }
+
+    inline CloudDensityView
+        getPaddedOldDensity(size_t channel)
+    {
+        return CloudDensityView(
+            channelStart(1, channel), getPaddedWidth(), getPaddedHeight());
+    }
+
+    inline ConstCloudDensityView
+        getPaddedOldDensity(size_t channel) const
+    {
+        return ConstCloudDensityView(
+            channelStart(1, channel), getPaddedWidth(), getPaddedHeight());
+    }
+
+    //! \returns The width without the halo
+    inline size_t
+        getWidth() const
+    {
+        return m_width;
+    }
+
+    //! \returns The height without the halo
+    inline size_t
+        getHeight() const
+    {
+        return m_height;
+    }
+
+    inline size_t
+        getHalo() const
+    {
+        return m_halo;
+    }
+
+    inline size_t
+        getPaddedWidth() const
+    {
+        return m_width + 2 * m_halo;
+    }
+
+    inline size_t
+        getPaddedHeight() const
+    {
+        return m_height + 2 * m_halo;
+    }
+
+    //! \returns The cells that aren't in the halo, in padded coordinates
+    inline CloudRegion
+        getInterior() const
+    {
+        return {m_halo, m_halo, m_halo + m_width, m_halo + m_height};
+    }
+
+    //! \brief Converts a region in padded coordinates to the normal ones.
+    //! The part in the halo is dropped
+    inline CloudRegion
+        toInterior(const CloudRegion& padded) const
+    {
+        const CloudRegion inside = padded.intersected(getInterior());
+
+        if(inside.isEmpty())
+            return {};
+
+        return {inside.startX - m_halo, inside.startY - m_halo,
+            inside.endX - m_halo, inside.endY - m_halo};
+    }
+
+    //! \returns The size of the whole buffer in bytes
+    inline size_t
+        getTotalBytes() const
+    {
+        return sizeof(CloudDensityValue) * getPaddedWidth() *
+               getPaddedHeight() * CLOUD_DENSITY_CHANNELS * 2;
+    }
+
+private:
+    template<class T>
+    inline BasicCloudDensityView<T>
+        interiorView(CloudDensityValue* start) const
+    {
+        const auto pitch = getPaddedWidth();
+        return BasicCloudDensityView<T>(
+            start + (m_halo * pitch + m_halo) *
+                        CloudDensityView::ELEMENT_STRIDE,
+            m_width, m_height, pitch);
+    }
+
+    //! \param block 0 for the current densities, 1 for the old ones
+    inline CloudDensityValue*
+        channelStart(size_t block, size_t channel) const
+    {
+        const auto cells = getPaddedWidth() * getPaddedHeight();
+
+        if constexpr(CLOUD_DENSITY_LAYOUT == CLOUD_CHANNEL_LAYOUT::PLANAR) {
+            return m_buffer.get() +
+                   (block * CLOUD_DENSITY_CHANNELS + channel) * cells;
+        } else {
+            return m_buffer.get() + block * CLOUD_DENSITY_CHANNELS * cells +
+                   channel;
+        }
+    }
+
+    std::unique_ptr<CloudDensityValue[], AlignedDeleter> m_buffer;
+
+    std::array<CloudRegion, CLOUD_DENSITY_CHANNELS> m_activeRegions;
+
+    size_t m_width = 0;
+    size_t m_height = 0;
+    size_t m_halo = 0;
+};
+
+} // namespace thrive
@@ -0,0 +1,666 @@
+// ------------------------------------ //
+#include "microbe_stage/cloud_simulation_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The vector kernels work on rows of floats so they aren't used with the half
+// float densities
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)) &&                                             \
+    !defined(THRIVE_HALF_CLOUD_DENSITIES)
+#define THRIVE_CLOUD_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+#endif
+
+// GCC and clang need the functions using the intrinsics to be marked so that
+// the rest of the code can still run on CPUs without them. MSVC allows using
+// them anywhere
+#if defined(THRIVE_CLOUD_KERNELS_X86) && !defined(_MSC_VER)
+#define THRIVE_TARGET_SSE2 __attribute__((target("sse2")))
+#define THRIVE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define THRIVE_TARGET_SSE2
+#define THRIVE_TARGET_AVX2
+#endif
+
+using namespace thrive;
+
+namespace {
+
+//! The vector kernels index the rows directly
+constexpr bool CONTIGUOUS_ROWS = ConstCloudDensityView::ELEMENT_STRIDE == 1;
+
+// ------------------------------------ //
+// Scalar
+void
+    diffuseScalar(float diffRate,
+        CloudDensityView oldDens,
+        ConstCloudDensityView density,
+        float dt,
+        const CloudRegion& area)
+{
+    float a = dt * diffRate;
+    for(size_t y = area.startY; y < area.endY; y++) {
+        for(size_t x = area.startX; x < area.endX; x++) {
+            oldDens(x, y) = density(x, y) * (1 - a) +
+                            (oldDens(x - 1, y) + oldDens(x + 1, y) +
+                                oldDens(x, y - 1) + oldDens(x, y + 1)) *
+                                a / 4;
+        }
+    }
+}
+
+//! \brief Scatters one cell with the bilinear weights
+//!
+//! This is also used by the vector versions for the cells left over at the
+//! end of a row
+inline void
+    advectCell(CloudDensityView density,
+        float source,
+        size_t x,
+        size_t y,
+        float dt,
+        float velocityX,
+        float velocityY)
+{
+    const float maxX = density.getWidth() - 1.5f;
+    const float maxY = density.getHeight() - 1.5f;
+
+    float dx = x + dt * velocityX;
+    float dy = y + dt * velocityY;
+
+    dx = std::clamp(dx, 0.5f, maxX);
+    dy = std::clamp(dy, 0.5f, maxY);
+
+    const int x0 = static_cast<int>(dx);
+    const int x1 = x0 + 1;
+    const int y0 = static_cast<int>(dy);
+    const int y1 = y0 + 1;
+
+    float s1 = dx - x0;
+    float s0 = 1.0f - s1;
+    float t1 = dy - y0;
+    float t0 = 1.0f - t1;
+
+    density(x0, y0) += source * s0 * t0;
+    density(x0, y1) += source * s0 * t1;
+    density(x1, y0) += source * s1 * t0;
+    density(x1, y1) += source * s1 * t1;
+}
+
+void
+    advectRowScalar(ConstCloudDensityView oldDens,
+        CloudDensityView density,
+        size_t y,
+        size_t startX,
+        size_t endX,
+        float dt,
+        const float* velocityX,
+        const float* velocityY)
+{
+    for(size_t x = startX; x < endX; x++) {
+
+        const float source = oldDens(x, y);
+
+        if(source > 1)
+            advectCell(
+                density, source, x, y, dt, velocityX[x], velocityY[x]);
+    }
+}
+
+#ifdef THRIVE_CLOUD_KERNELS_X86
+// ------------------------------------ //
+// Shared parts of the vector versions
+
+//! \brief The vector diffuse is split into a vectorized pass that handles the
+//! right, up and down neighbours and a scalar pass for the left neighbour as
+//! that has been updated just before (this is Gauss-Seidel)
+template<void (*RowPass)(float*,
+    const float*,
+    const float*,
+    const float*,
+    size_t,
+    size_t,
+    float,
+    float)>
+void
+    diffuseVector(float diffRate,
+        CloudDensityView oldDens,
+        ConstCloudDensityView density,
+        float dt,
+        const CloudRegion& area)
+{
+    const float a = dt * diffRate;
+    const float keep = 1 - a;
+    const float quarter = a / 4;
+
+    for(size_t y = area.startY; y < area.endY; y++) {
+
+        float* const row = oldDens.row(y);
+
+        RowPass(row, oldDens.row(y - 1), oldDens.row(y + 1), density.row(y),
+            area.startX, area.endX, keep, quarter);
+
+        for(size_t x = area.startX; x < area.endX; x++)
+            row[x] += row[x - 1] * quarter;
+    }
+}
+
+//! \brief Row pass tail that handles what doesn't fit in a full vector
+inline void
+    diffuseRowRemainder(float* row,
+        const float* up,
+        const float* down,
+        const float* dens,
+        size_t x,
+        size_t endX,
+        float keep,
+        float quarter)
+{
+    for(; x < endX; ++x)
+        row[x] = dens[x] * keep + (row[x + 1] + up[x] + down[x]) * quarter;
+}
+
+//! \brief Scatters the lanes set in mask that the vector code computed
+template<size_t Lanes>
+inline void
+    scatterAdvectedLanes(CloudDensityView density,
+        int mask,
+        const int* x0,
+        const int* y0,
+        const float* w00,
+        const float* w01,
+        const float* w10,
+        const float* w11)
+{
+    for(size_t lane = 0; lane < Lanes; ++lane) {
+
+        if(!(mask & (1 << lane)))
+            continue;
+
+        density(x0[lane], y0[lane]) += w00[lane];
+        density(x0[lane], y0[lane] + 1) += w01[lane];
+        density(x0[lane] + 1, y0[lane]) += w10[lane];
+        density(x0[lane] + 1, y0[lane] + 1) += w11[lane];
+    }
+}
+
+// ------------------------------------ //
+// SSE2
+THRIVE_TARGET_SSE2 void
+    diffuseRowPassSSE2(float* row,
+        const float* up,
+        const float* down,
+        const float* dens,
+        size_t startX,
+        size_t endX,
+        float keep,
+        float quarter)
+{
+    const __m128 keepV = _mm_set1_ps(keep);
+    const __m128 quarterV = _mm_set1_ps(quarter);
+
+    // The right neighbours of a block are loaded before the block is written
+    // so this can be done in place
+    size_t x = startX;
+    for(; x + 4 <= endX; x += 4) {
+
+        const __m128 neighbours = _mm_add_ps(
+            _mm_add_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(up + x)),
+            _mm_loadu_ps(down + x));
+
+        _mm_storeu_ps(row + x,
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dens + x), keepV),
+                _mm_mul_ps(neighbours, quarterV)));
+    }
+
+    diffuseRowRemainder(row, up, down, dens, x, endX, keep, quarter);
+}
+
+THRIVE_TARGET_SSE2 void
+    advectRowSSE2(ConstCloudDensityView oldDens,
+        CloudDensityView density,
+        size_t y,
+        size_t startX,
+        size_t endX,
+        float dt,
+        const float* velocityX,
+        const float* velocityY)
+{
+    const auto width = oldDens.getWidth();
+    const float* const source = oldDens.row(y);
+
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 dtV = _mm_set1_ps(dt);
+    const __m128 yV = _mm_set1_ps(static_cast<float>(y));
+    const __m128 minV = _mm_set1_ps(0.5f);
+    const __m128 maxX = _mm_set1_ps(width - 1.5f);
+    const __m128 maxY = _mm_set1_ps(density.getHeight() - 1.5f);
+    const __m128 laneOffsets = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+
+    alignas(16) int x0[4];
+    alignas(16) int y0[4];
+    alignas(16) float w00[4];
+    alignas(16) float w01[4];
+    alignas(16) float w10[4];
+    alignas(16) float w11[4];
+
+    size_t x = startX;
+    for(; x + 4 <= endX; x += 4) {
+
+        const __m128 src = _mm_loadu_ps(source + x);
+        const int mask = _mm_movemask_ps(_mm_cmpgt_ps(src, one));
+
+        if(!mask)
+            continue;
+
+        const __m128 xV =
+            _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+
+        __m128 dx =
+            _mm_add_ps(xV, _mm_mul_ps(dtV, _mm_loadu_ps(velocityX + x)));
+        __m128 dy =
+            _mm_add_ps(yV, _mm_mul_ps(dtV, _mm_loadu_ps(velocityY + x)));
+
+        dx = _mm_min_ps(_mm_max_ps(dx, minV), maxX);
+        dy = _mm_min_ps(_mm_max_ps(dy, minV), maxY);
+
+        // Truncation is flooring here as the values are positive
+        const __m128i x0V = _mm_cvttps_epi32(dx);
+        const __m128i y0V = _mm_cvttps_epi32(dy);
+
+        const __m128 s1 = _mm_sub_ps(dx, _mm_cvtepi32_ps(x0V));
+        const __m128 s0 = _mm_sub_ps(one, s1);
+        const __m128 t1 = _mm_sub_ps(dy, _mm_cvtepi32_ps(y0V));
+        const __m128 t0 = _mm_sub_ps(one, t1);
+
+        const __m128 srcS0 = _mm_mul_ps(src, s0);
+        const __m128 srcS1 = _mm_mul_ps(src, s1);
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(x0), x0V);
+        _mm_store_si128(reinterpret_cast<__m128i*>(y0), y0V);
+        _mm_store_ps(w00, _mm_mul_ps(srcS0, t0));
+        _mm_store_ps(w01, _mm_mul_ps(srcS0, t1));
+        _mm_store_ps(w10, _mm_mul_ps(srcS1, t0));
+        _mm_store_ps(w11, _mm_mul_ps(srcS1, t1));
+
+        scatterAdvectedLanes<4>(density, mask, x0, y0, w00, w01, w10, w11);
+    }
+
+    for(; x < endX; ++x) {
+        if(source[x] > 1)
+            advectCell(
+                density, source[x], x, y, dt, velocityX[x], velocityY[x]);
+    }
+}
+
+// ------------------------------------ //
+// AVX2
+THRIVE_TARGET_AVX2 void
+    diffuseRowPassAVX2(float* row,
+        const float* up,
+        const float* down,
+        const float* dens,
+        size_t startX,
+        size_t endX,
+        float keep,
+        float quarter)
+{
+    const __m256 keepV = _mm256_set1_ps(keep);
+    const __m256 quarterV = _mm256_set1_ps(quarter);
+
+    size_t x = startX;
+    for(; x + 8 <= endX; x += 8) {
+
+        const __m256 neighbours =
+            _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(row + x + 1),
+                              _mm256_loadu_ps(up + x)),
+                _mm256_loadu_ps(down + x));
+
+        _mm256_storeu_ps(row + x,
+            _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(dens + x), keepV),
+                _mm256_mul_ps(neighbours, quarterV)));
+    }
+
+    diffuseRowRemainder(row, up, down, dens, x, endX, keep, quarter);
+}
+
+THRIVE_TARGET_AVX2 void
+    advectRowAVX2(ConstCloudDensityView oldDens,
+        CloudDensityView density,
+        size_t y,
+        size_t startX,
+        size_t endX,
+        float dt,
+        const float* velocityX,
+        const float* velocityY)
+{
+    const auto width = oldDens.getWidth();
+    const float* const source = oldDens.row(y);
+
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 dtV = _mm256_set1_ps(dt);
+    const __m256 yV = _mm256_set1_ps(static_cast<float>(y));
+    const __m256 minV = _mm256_set1_ps(0.5f);
+    const __m256 maxX = _mm256_set1_ps(width - 1.5f);
+    const __m256 maxY = _mm256_set1_ps(density.getHeight() - 1.5f);
+    const __m256 laneOffsets =
+        _mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+
+    alignas(32) int x0[8];
+    alignas(32) int y0[8];
+    alignas(32) float w00[8];
+    alignas(32) float w01[8];
+    alignas(32) float w10[8];
+    alignas(32) float w11[8];
+
+    size_t x = startX;
+    for(; x + 8 <= endX; x += 8) {
+
+        const __m256 src = _mm256_loadu_ps(source + x);
+        const int mask =
+            _mm256_movemask_ps(_mm256_cmp_ps(src, one, _CMP_GT_OQ));
+
+        if(!mask)
+            continue;
+
+        const __m256 xV =
+            _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+
+        __m256 dx = _mm256_add_ps(
+            xV, _mm256_mul_ps(dtV, _mm256_loadu_ps(velocityX + x)));
+        __m256 dy = _mm256_add_ps(
+            yV, _mm256_mul_ps(dtV, _mm256_loadu_ps(velocityY + x)));
+
+        dx = _mm256_min_ps(_mm256_max_ps(dx, minV), maxX);
+        dy = _mm256_min_ps(_mm256_max_ps(dy, minV), maxY);
+
+        const __m256i x0V = _mm256_cvttps_epi32(dx);
+        const __m256i y0V = _mm256_cvttps_epi32(dy);
+
+        const __m256 s1 = _mm256_sub_ps(dx, _mm256_cvtepi32_ps(x0V));
+        const __m256 s0 = _mm256_sub_ps(one, s1);
+        const __m256 t1 = _mm256_sub_ps(dy, _mm256_cvtepi32_ps(y0V));
+        const __m256 t0 = _mm256_sub_ps(one, t1);
+
+        const __m256 srcS0 = _mm256_mul_ps(src, s0);
+        const __m256 srcS1 = _mm256_mul_ps(src, s1);
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(x0), x0V);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(y0), y0V);
+        _mm256_store_ps(w00, _mm256_mul_ps(srcS0, t0));
+        _mm256_store_ps(w01, _mm256_mul_ps(srcS0, t1));
+        _mm256_store_ps(w10, _mm256_mul_ps(srcS1, t0));
+        _mm256_store_ps(w11, _mm256_mul_ps(srcS1, t1));
+
+        scatterAdvectedLanes<8>(density, mask, x0, y0, w00, w01, w10, w11);
+    }
+
+    for(; x < endX; ++x) {
+        if(source[x] > 1)
+            advectCell(
+                density, source[x], x, y, dt, velocityX[x], velocityY[x]);
+    }
+}
+
+// ------------------------------------ //
+// CPU feature detection
+#ifdef _MSC_VER
+bool
+    cpuHasAVX2()
+{
+    int info[4];
+    __cpuid(info, 0);
+
+    if(info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+
+    // The OS needs to save the AVX registers
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+
+    if(!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+bool
+    cpuHasSSE2()
+{
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+}
+#else
+bool
+    cpuHasAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+bool
+    cpuHasSSE2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+#endif // _MSC_VER
+
+#endif // THRIVE_CLOUD_KERNELS_X86
+
+} // namespace
+
+// ------------------------------------ //
+// CloudSimulationKernels
+CloudSimulationKernels::CloudSimulationKernels() :
+    m_isa(detectBestSupported())
+{}
+
+CloudSimulationKernels::CloudSimulationKernels(CLOUD_KERNEL_ISA isa) :
+    m_isa(isSupported(isa) ? isa : detectBestSupported())
+{}
+// ------------------------------------ //
+void
+    CloudSimulationKernels::diffuse(float diffRate,
+        CloudDensityView oldDens,
+        ConstCloudDensityView density,
+        float dt) const
+{
+    diffuse(diffRate, oldDens, density, dt,
+        CloudRegion{0, 0, oldDens.getWidth(), oldDens.getHeight()});
+}
+
+void
+    CloudSimulationKernels::diffuse(float diffRate,
+        CloudDensityView oldDens,
+        ConstCloudDensityView density,
+        float dt,
+        const CloudRegion& area) const
+{
+    // The border cells are never diffused
+    const CloudRegion interior{std::max<size_t>(area.startX, 1),
+        std::max<size_t>(area.startY, 1),
+        std::min(area.endX, oldDens.getWidth() - 1),
+        std::min(area.endY, oldDens.getHeight() - 1)};
+
+    if(interior.isEmpty())
+        return;
+
+    switch(m_isa) {
+#ifdef THRIVE_CLOUD_KERNELS_X86
+    case CLOUD_KERNEL_ISA::AVX2:
+        diffuseVector<diffuseRowPassAVX2>(
+            diffRate, oldDens, density, dt, interior);
+        return;
+    case CLOUD_KERNEL_ISA::SSE2:
+        diffuseVector<diffuseRowPassSSE2>(
+            diffRate, oldDens, density, dt, interior);
+        return;
+#endif // THRIVE_CLOUD_KERNELS_X86
+    default: diffuseScalar(diffRate, oldDens, density, dt, interior); return;
+    }
+}
+
+void
+    CloudSimulationKernels::diffuseImplicit(float diffRate,
+        CloudDensityView oldDens,
+        ConstCloudDensityView density,
+        float dt,
+        const CloudRegion& area,
+        int iterations) const
+{
+    // The border cells are never diffused
+    const CloudRegion interior{std::max<size_t>(area.startX, 1),
+        std::max<size_t>(area.startY, 1),
+        std::min(area.endX, oldDens.getWidth() - 1),
+        std::min(area.endY, oldDens.getHeight() - 1)};
+
+    if(interior.isEmpty())
+        return;
+
+    // Solves (1 + a) * x - a / 4 * (sum of the neighbours of x) = density.
+    // This is diagonally dominant for all a so the iterations always
+    // converge
+    const float a = dt * diffRate;
+    const float quarter = a / 4;
+    const float scale = 1 / (1 + a);
+
+    // The iterations converge slower the longer the step is
+    iterations = std::clamp(static_cast<int>(std::ceil(2 * a)), iterations,
+        std::max(iterations, MAX_IMPLICIT_DIFFUSION_ITERATIONS));
+
+    for(size_t y = interior.startY; y < interior.endY; y++) {
+        for(size_t x = interior.startX; x < interior.endX; x++)
+            oldDens(x, y) = density(x, y);
+    }
+
+    // The red cells only depend on the black ones and the other way around
+    for(int i = 0; i < iterations; ++i) {
+        for(size_t colour = 0; colour < 2; ++colour) {
+            for(size_t y = interior.startY; y < interior.endY; y++) {
+
+                const size_t startX =
+                    interior.startX + ((interior.startX + y + colour) & 1);
+
+                for(size_t x = startX; x < interior.endX; x += 2) {
+                    oldDens(x, y) =
+                        (density(x, y) +
+                            (oldDens(x - 1, y) + oldDens(x + 1, y) +
+                                oldDens(x, y - 1) + oldDens(x, y + 1)) *
+                                quarter) *
+                        scale;
+                }
+            }
+        }
+    }
+}
+
+void
+    CloudSimulationKernels::advectRow(ConstCloudDensityView oldDens,
+        CloudDensityView density,
+        size_t y,
+        size_t startX,
+        size_t endX,
+        float dt,
+        const float* velocityX,
+        const float* velocityY) const
+{
+    switch(m_isa) {
+#ifdef THRIVE_CLOUD_KERNELS_X86
+    case CLOUD_KERNEL_ISA::AVX2:
+        advectRowAVX2(
+            oldDens, density, y, startX, endX, dt, velocityX, velocityY);
+        return;
+    case CLOUD_KERNEL_ISA::SSE2:
+        advectRowSSE2(
+            oldDens, density, y, startX, endX, dt, velocityX, velocityY);
+        return;
+#endif // THRIVE_CLOUD_KERNELS_X86
+    default:
+        advectRowScalar(
+            oldDens, density, y, startX, endX, dt, velocityX, velocityY);
+        return;
+    }
+}
+
+CloudRegion
+    CloudSimulationKernels::trimToOccupied(CloudDensityView view,
+        const CloudRegion& area,
+        float threshold)
+{
+    CloudRegion occupied;
+
+    for(size_t y = area.startY; y < area.endY; ++y) {
+        for(size_t x = area.startX; x < area.endX; ++x) {
+            if(view(x, y) > threshold)
+                occupied.include(x, y);
+        }
+    }
+
+    // Clear the rest. The rows above and below the occupied part are cleared
+    // completely and the rows in between only on the sides
+    for(size_t y = area.startY; y < area.endY; ++y) {
+
+        const bool insideRows = y >= occupied.startY && y < occupied.endY;
+
+        for(size_t x = area.startX; x < area.endX; ++x) {
+            if(!insideRows || x < occupied.startX || x >= occupied.endX)
+                view(x, y) = 0;
+        }
+    }
+
+    return occupied;
+}
+// ------------------------------------ //
+const char*
+    CloudSimulationKernels::getISAName() const
+{
+    switch(m_isa) {
+    case CLOUD_KERNEL_ISA::SCALAR: return "scalar";
+    case CLOUD_KERNEL_ISA::SSE2: return "SSE2";
+    case CLOUD_KERNEL_ISA::AVX2: return "AVX2";
+    }
+
+    return "unknown";
+}
+
+bool
+    CloudSimulationKernels::isSupported(CLOUD_KERNEL_ISA isa)
+{
+    if(isa == CLOUD_KERNEL_ISA::SCALAR)
+        return true;
+
+    if constexpr(!CONTIGUOUS_ROWS)
+        return false;
+
+#ifdef THRIVE_CLOUD_KERNELS_X86
+    switch(isa) {
+    case CLOUD_KERNEL_ISA::SSE2: return cpuHasSSE2();
+    case CLOUD_KERNEL_ISA::AVX2: return cpuHasAVX2();
+    default: return false;
+    }
+#else
+    return false;
+#endif // THRIVE_CLOUD_KERNELS_X86
+}
+
+CLOUD_KERNEL_ISA
+    CloudSimulationKernels::detectBestSupported()
+{
+    if(isSupported(CLOUD_KERNEL_ISA::AVX2))
+        return CLOUD_KERNEL_ISA::AVX2;
+
+    if(isSupported(CLOUD_KERNEL_ISA::SSE2))
+        return CLOUD_KERNEL_ISA::SSE2;
+
+    return CLOUD_KERNEL_ISA::SCALAR;
+}
@@ -0,0 +1,125 @@
+#pragma once
+// Thrive Game
+// Copyright (C) 2013-2019  Revolutionary Games
+// ------------------------------------ //
+#include "microbe_stage/cloud_density_storage.h"
+
+namespace thrive {
+
+//! \brief The instruction sets the cloud kernels have implementations for
+enum class CLOUD_KERNEL_ISA { SCALAR, SSE2, AVX2 };
+
+//! \brief Vectorized implementations of the compound cloud simulation steps
+//!
+//! The best implementation supported by the CPU is selected at runtime. The
+//! scalar version is always available and is exactly the old algorithm. The
+//! vector versions produce the same results within float rounding error.
+//! \note When CLOUD_DENSITY_LAYOUT is INTERLEAVED the scalar versions are
+//! always used as the vector versions need contiguous rows
+class CloudSimulationKernels {
+public:
+    //! Default amount of iterations for diffuseImplicit
+    static constexpr int IMPLICIT_DIFFUSION_ITERATIONS = 4;
+
+    //! diffuseImplicit adds iterations for long steps up to this
+    static constexpr int MAX_IMPLICIT_DIFFUSION_ITERATIONS = 32;
+
+    //! How far diffuseImplicit spreads things that matter in one step. What
+    //! spreads further is below the cloud empty threshold
+    static constexpr size_t IMPLICIT_DIFFUSION_REACH = 2;
+
+    //! \brief Uses the best implementation the CPU supports
+    CloudSimulationKernels();
+
+    //! \brief Uses the specified implementation or the best supported one if
+    //! it isn't supported
+    explicit CloudSimulationKernels(CLOUD_KERNEL_ISA isa);
+
+    //! \brief Diffuses density into oldDens
+    //!
+    //! This is a single Gauss-Seidel sweep, the border cells aren't touched
+    void
+        diffuse(float diffRate,
+            CloudDensityView oldDens,
+            ConstCloudDensityView density,
+            float dt) const;
+
+    //! \brief Diffuses only the cells in area (excluding the border cells)
+    //!
+    //! The cells outside area are treated as if they were already zero in
+    //! oldDens. The result is the same as the full version when everything
+    //! outside area is zero in both density and oldDens, apart from the tiny
+    //! amounts that the sweep would have carried further right and down
+    void
+        diffuse(float diffRate,
+            CloudDensityView oldDens,
+            ConstCloudDensityView density,
+            float dt,
+            const CloudRegion& area) const;
+
+    //! \brief Implicit (backward Euler) version of diffuse
+    //!
+    //! Solves the diffusion with red-black Gauss-Seidel iterations starting
+    //! from density. Unlike diffuse this stays stable and doesn't produce
+    //! negative densities however large dt * diffRate is, so it can be used
+    //! with long timesteps. The cells outside area are treated as zero like
+    //! in diffuse, so area should be expanded by IMPLICIT_DIFFUSION_REACH
+    //! around everything that has something in it
+    //! \param iterations The minimum amount of iterations. More are done
+    //! when dt * diffRate is large
+    void
+        diffuseImplicit(float diffRate,
+            CloudDensityView oldDens,
+            ConstCloudDensityView density,
+            float dt,
+            const CloudRegion& area,
+            int iterations = IMPLICIT_DIFFUSION_ITERATIONS) const;
+
+    //! \brief Moves the density of row y of oldDens according to the
+    //! velocities and adds it to density
+    //!
+    //! Only the columns [startX, endX) are moved, these must not include the
+    //! border columns. The velocities are per cell of the row (indexed by x)
+    //! and already scaled with the viscosity. The velocity of cells with
+    //! density of 1 or less isn't read.
+    void
+        advectRow(ConstCloudDensityView oldDens,
+            CloudDensityView density,
+            size_t y,
+            size_t startX,
+            size_t endX,
+            float dt,
+            const float* velocityX,
+            const float* velocityY) const;
+
+    //! \brief Finds the part of area that has cells above threshold
+    //!
+    //! The cells in area that are outside the returned region are set to 0.
+    //! They can only have values of at most threshold so nothing meaningful is
+    //! lost, but this stops the diffusion from growing the active regions of
+    //! the clouds forever.
+    static CloudRegion
+        trimToOccupied(
+            CloudDensityView view, const CloudRegion& area, float threshold);
+
+    CLOUD_KERNEL_ISA
+        getISA() const
+    {
+        return m_isa;
+    }
+
+    //! \returns The name of the used ISA, for logging
+    const char*
+        getISAName() const;
+
+    static bool
+        isSupported(CLOUD_KERNEL_ISA isa);
+
+    static CLOUD_KERNEL_ISA
+        detectBestSupported();
+
+private:
+    CLOUD_KERNEL_ISA m_isa;
+};
+
+} // namespace thrive
@@ -0,0 +1,192 @@
+// ------------------------------------ //
+#include "microbe_stage/cloud_tile_cache.h"
+
+#include <limits>
+
+using namespace thrive;
+
+namespace {
+constexpr auto MAX_QUANTIZED = std::numeric_limits<uint16_t>::max();
+
+//! Rough size of the list and map nodes of one tile
+constexpr size_t TILE_OVERHEAD_BYTES = 64;
+} // namespace
+
+// ------------------------------------ //
+CloudTileCache::CloudTileCache(size_t maxBytes) : m_maxBytes(maxBytes) {}
+// ------------------------------------ //
+void
+    CloudTileCache::store(const CloudTileKey& key,
+        const CloudDensityStorage& storage)
+{
+    // Remove the old version first so that it doesn't count towards the limit
+    const auto existing = m_index.find(key);
+
+    if(existing != m_index.end()) {
+        m_usedBytes -= existing->second->getBytes();
+        m_tiles.erase(existing->second);
+        m_index.erase(existing);
+    }
+
+    Tile tile;
+    tile.key = key;
+    tile.width = storage.getWidth();
+    tile.height = storage.getHeight();
+
+    bool empty = true;
+
+    for(size_t i = 0; i < CLOUD_DENSITY_CHANNELS; ++i) {
+
+        const CloudRegion region =
+            storage.toInterior(storage.getActiveRegion(i));
+
+        if(region.isEmpty())
+            continue;
+
+        const ConstCloudDensityView density = storage.getDensity(i);
+
+        float maxValue = 0;
+
+        for(size_t y = region.startY; y < region.endY; ++y) {
+            for(size_t x = region.startX; x < region.endX; ++x)
+                maxValue = std::max<float>(maxValue, density(x, y));
+        }
+
+        if(maxValue <= 0)
+            continue;
+
+        Channel& channel = tile.channels[i];
+        channel.region = region;
+        channel.scale = maxValue / MAX_QUANTIZED;
+
+        const float toQuantized = 1 / channel.scale;
+
+        uint16_t current = 0;
+        uint16_t count = 0;
+
+        for(size_t y = region.startY; y < region.endY; ++y) {
+            for(size_t x = region.startX; x < region.endX; ++x) {
+
+                const auto quantized = static_cast<uint16_t>(std::min(
+                    density(x, y) * toQuantized + 0.5f,
+                    static_cast<float>(MAX_QUANTIZED)));
+
+                if(count != 0 && quantized == current &&
+                    count < MAX_QUANTIZED) {
+                    ++count;
+                    continue;
+                }
+
+                if(count != 0) {
+                    channel.runs.push_back(count);
+                    channel.runs.push_back(current);
+                }
+
+                current = quantized;
+                count = 1;
+            }
+        }
+
+        channel.runs.push_back(count);
+        channel.runs.push_back(current);
+        channel.runs.shrink_to_fit();
+
+        empty = false;
+    }
+
+    if(empty)
+        return;
+
+    m_usedBytes += tile.getBytes();
+    m_tiles.push_front(std::move(tile));
+    m_index[key] = m_tiles.begin();
+
+    evictToFit();
+}
+
+bool
+    CloudTileCache::restore(const CloudTileKey& key,
+        CloudDensityStorage& storage)
+{
+    const auto found = m_index.find(key);
+
+    if(found == m_index.end())
+        return false;
+
+    const auto iter = found->second;
+    m_index.erase(found);
+
+    // The size can't change while the game runs, but just in case this
+    // doesn't write past the end
+    const bool valid = iter->width == storage.getWidth() &&
+                       iter->height == storage.getHeight();
+
+    for(size_t i = 0; valid && i < CLOUD_DENSITY_CHANNELS; ++i) {
+
+        const Channel& channel = iter->channels[i];
+
+        if(channel.region.isEmpty())
+            continue;
+
+        const CloudDensityView density = storage.getDensity(i);
+        const CloudRegion& region = channel.region;
+
+        size_t x = region.startX;
+        size_t y = region.startY;
+
+        for(size_t run = 0; run < channel.runs.size(); run += 2) {
+
+            const float value = channel.runs[run + 1] * channel.scale;
+
+            for(uint16_t j = 0; j < channel.runs[run]; ++j) {
+
+                density(x, y) = value;
+
+                if(++x == region.endX) {
+                    x = region.startX;
+                    ++y;
+                }
+            }
+        }
+
+        const size_t halo = storage.getHalo();
+        storage.getActiveRegion(i) = {region.startX + halo,
+            region.startY + halo, region.endX + halo, region.endY + halo};
+    }
+
+    m_usedBytes -= iter->getBytes();
+    m_tiles.erase(iter);
+    return valid;
+}
+
+void
+    CloudTileCache::clear()
+{
+    m_tiles.clear();
+    m_index.clear();
+    m_usedBytes = 0;
+}
+// ------------------------------------ //
+void
+    CloudTileCache::evictToFit()
+{
+    while(m_usedBytes > m_maxBytes && !m_tiles.empty()) {
+
+        const Tile& oldest = m_tiles.back();
+
+        m_usedBytes -= oldest.getBytes();
+        m_index.erase(oldest.key);
+        m_tiles.pop_back();
+    }
+}
+// ------------------------------------ //
+size_t
+    CloudTileCache::Tile::getBytes() const
+{
+    size_t bytes = sizeof(Tile) + TILE_OVERHEAD_BYTES;
+
+    for(const auto& channel : channels)
+        bytes += channel.runs.capacity() * sizeof(uint16_t);
+
+    return bytes;
+}
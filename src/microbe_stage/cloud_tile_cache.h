@@ -0,0 +1,119 @@
+#pragma once
+// Thrive Game
+// Copyright (C) 2013-2019  Revolutionary Games
+// ------------------------------------ //
+#include "engine/typedefs.h"
+#include "microbe_stage/cloud_density_storage.h"
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace thrive {
+
+//! \brief Identifies a cloud that isn't loaded
+struct CloudTileKey {
+    //! Position of the cloud in the cloud grid (position / cloud extent)
+    int x;
+    int z;
+
+    //! The first compound of the cloud group
+    CompoundId group;
+
+    inline bool
+        operator==(const CloudTileKey& other) const
+    {
+        return x == other.x && z == other.z && group == other.group;
+    }
+};
+
+struct CloudTileKeyHash {
+    inline size_t
+        operator()(const CloudTileKey& key) const
+    {
+        // The grid coordinates are small so this doesn't collide much
+        return (static_cast<size_t>(static_cast<uint32_t>(key.x)) * 73856093) ^
+               (static_cast<size_t>(static_cast<uint32_t>(key.z)) * 19349663) ^
+               (static_cast<size_t>(key.group) * 83492791);
+    }
+};
+
+//! \brief Keeps the contents of the clouds the player has moved away from
+//!
+//! The densities are quantized to 16 bits and run length encoded. Only the
+//! active regions are stored. When the cache goes over its memory limit the
+//! least recently stored tiles are dropped
+class CloudTileCache {
+public:
+    //! \param maxBytes How much memory the compressed tiles can use in total
+    explicit CloudTileCache(size_t maxBytes = 8 * 1024 * 1024);
+
+    //! \brief Compresses the contents of storage and stores them under key
+    //!
+    //! Replaces anything already stored for key. Empty clouds aren't stored
+    void
+        store(const CloudTileKey& key, const CloudDensityStorage& storage);
+
+    //! \brief Restores the tile for key into storage and removes it from this
+    //!
+    //! storage needs to be cleared and have the same size as the stored one
+    //! \returns False if there is no tile for key. storage isn't touched then
+    bool
+        restore(const CloudTileKey& key, CloudDensityStorage& storage);
+
+    void
+        clear();
+
+    //! \returns How many tiles are stored
+    size_t
+        size() const
+    {
+        return m_tiles.size();
+    }
+
+    //! \returns The memory used by the compressed tiles
+    size_t
+        getUsedBytes() const
+    {
+        return m_usedBytes;
+    }
+
+private:
+    //! \brief One compressed channel
+    struct Channel {
+        //! In the coordinates without the halo
+        CloudRegion region;
+
+        //! Multiplier from the quantized values to densities
+        float scale = 0;
+
+        //! (run length, quantized value) pairs covering region row by row
+        std::vector<uint16_t> runs;
+    };
+
+    struct Tile {
+        CloudTileKey key;
+        size_t width;
+        size_t height;
+        std::array<Channel, CLOUD_DENSITY_CHANNELS> channels;
+
+        size_t
+            getBytes() const;
+    };
+
+    void
+        evictToFit();
+
+private:
+    //! Most recently stored first
+    std::list<Tile> m_tiles;
+
+    std::unordered_map<CloudTileKey, std::list<Tile>::iterator,
+        CloudTileKeyHash>
+        m_index;
+
+    const size_t m_maxBytes;
+    size_t m_usedBytes = 0;
+};
+
+} // namespace thrive
@@ -228,24 +228,17 @@ void
 
                         // Absorb all of the 4 compounds that can be in a cloud
                         // entity
+                        for(size_t channel = 0; channel < CLOUDS_IN_ONE;
+                            ++channel) {
 
-                        const auto id1 = compoundCloud->getCompoundId1();
-                        const auto id2 = compoundCloud->getCompoundId2();
-                        const auto id3 = compoundCloud->getCompoundId3();
-                        const auto id4 = compoundCloud->getCompoundId4();
-
-                        if(id1 != NULL_COMPOUND &&
-                            absorber.canAbsorbCompound(id1))
-                            absorbFromCloud(compoundCloud, id1, absorber, x, y);
-                        if(id2 != NULL_COMPOUND &&
-                            absorber.canAbsorbCompound(id2))
-                            absorbFromCloud(compoundCloud, id2, absorber, x, y);
-                        if(id3 != NULL_COMPOUND &&
-                            absorber.canAbsorbCompound(id3))
-                            absorbFromCloud(compoundCloud, id3, absorber, x, y);
-                        if(id4 != NULL_COMPOUND &&
-                            absorber.canAbsorbCompound(id4))
-                            absorbFromCloud(compoundCloud, id4, absorber, x, y);
+                            const auto id =
+                                compoundCloud->getCompoundIdForChannel(channel);
+
+                            if(id != NULL_COMPOUND &&
+                                absorber.canAbsorbCompound(id))
+                                absorbFromCloud(compoundCloud, channel, id,
+                                    absorber, localX, localY);
+                        }
                     }
                 }
             }
@@ -288,12 +281,14 @@ void
 void
     CompoundAbsorberSystem::absorbFromCloud(
         CompoundCloudComponent* compoundCloud,
+        size_t channel,
         CompoundId id,
         CompoundAbsorberComponent& absorber,
-        int x,
-        int y)
+        size_t x,
+        size_t y)
 {
-    float amount = compoundCloud->amountAvailable(id, x, y, .2) / 5000.0f;
+    float amount =
+        compoundCloud->amountAvailableInChannel(channel, x, y, .2) / 5000.0f;
 
     if(amount < Leviathan::EPSILON)
         return;
@@ -315,7 +310,8 @@ void
         //           " at (cloud local): " + std::to_string(x) + ", " +
         //           std::to_string(y) + " amount: " + std::to_string(amount));
         absorber.m_absorbedCompounds[id] +=
-            compoundCloud->takeCompound(id, x, y, .4) / 80000.0f;
+            compoundCloud->takeCompoundFromChannel(channel, x, y, .4) /
+            80000.0f;
     }
     // Absorb .2 (third parameter) of the available
     // compounds.
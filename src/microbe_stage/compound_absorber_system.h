@@ -226,12 +226,14 @@ public:
     }
 
 private:
+    //! \param channel The channel in compoundCloud that has id
     void
         absorbFromCloud(CompoundCloudComponent* compoundCloud,
+            size_t channel,
             CompoundId id,
             CompoundAbsorberComponent& absorber,
-            int x,
-            int y);
+            size_t x,
+            size_t y);
 
 private:
     // All entities that have a compoundCloudsComponent.
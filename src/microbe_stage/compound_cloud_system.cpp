@@ -4,6 +4,7 @@
 #include "ThriveGame.h"
 
 #include "engine/player_data.h"
+#include "general/thread_pool.h"
 #include "generated/cell_stage_world.h"
 
 #include <Rendering/GeometryHelpers.h>
@@ -16,8 +17,254 @@
 
 using namespace thrive;
 
-constexpr auto CLOUD_TEXTURE_BYTES_PER_ELEMENT = 4;
-constexpr auto BS_PIXEL_FORMAT = bs::PF_RGBA8;
+
+static_assert(
+    CLOUD_HALO == 1, "the halo exchange only handles one cell wide halos");
+
+namespace {
+bs::PixelFormat
+    getPixelFormat(CLOUD_TEXTURE_FORMAT format)
+{
+    return format == CLOUD_TEXTURE_FORMAT::HALF_FLOAT ? bs::PF_RGBA16F :
+                                                        bs::PF_RGBA8;
+}
+
+size_t
+    getTexelBytes(CLOUD_TEXTURE_FORMAT format)
+{
+    return format == CLOUD_TEXTURE_FORMAT::HALF_FLOAT ?
+               CLOUDS_IN_ONE * sizeof(uint16_t) :
+               CLOUDS_IN_ONE;
+}
+
+//! The atlases have all the 9 clouds of a group in a 3x3 grid
+constexpr size_t CLOUD_ATLAS_WIDTH = CLOUD_SIMULATION_WIDTH * 3;
+constexpr size_t CLOUD_ATLAS_HEIGHT = CLOUD_SIMULATION_HEIGHT * 3;
+
+//! From row major order of the cloud grid to the order
+//! calculateGridPositions uses
+constexpr int GRID_ORDER[9] = {1, 2, 3, 4, 0, 5, 6, 7, 8};
+
+//! \brief The halo cells moving in one direction on one axis
+struct HaloAxis {
+    size_t source;
+    size_t target;
+    size_t count;
+    uint8_t side;
+};
+
+//! \param direction Where the cells move to on this axis, -1, 0 or 1
+//! \param fromNeighbour True when the cells come from the halo of the
+//! neighbour in direction. Otherwise they come from the own halo on that side
+//! and there is no neighbour to move them to
+//! \param size The cloud size on this axis without the halo
+HaloAxis
+    haloAxis(int direction,
+        bool fromNeighbour,
+        size_t size,
+        uint8_t lowSide,
+        uint8_t highSide)
+{
+    if(direction == 0)
+        return {1, 1, size, 0};
+
+    // The neighbour on the low side moves things from its high side halo
+    const bool low = (direction < 0) != fromNeighbour;
+
+    return {low ? 0 : size + 1, direction < 0 ? 1 : size, 1,
+        low ? lowSide : highSide};
+}
+
+//! \brief Copies the cells of row sourceY that aren't in the halo to row
+//! targetY
+void
+    copyCloudRow(ConstCloudDensityView source,
+        size_t sourceY,
+        CloudDensityView target,
+        size_t targetY,
+        size_t width)
+{
+    if constexpr(CloudDensityView::ELEMENT_STRIDE == 1) {
+        std::memcpy(target.row(targetY) + 1, source.row(sourceY) + 1,
+            sizeof(CloudDensityValue) * width);
+    } else {
+        for(size_t x = 1; x <= width; ++x)
+            target(x, targetY) = source(x, sourceY);
+    }
+}
+
+//! \returns The CLOUD_HALO_SIDE flags of the halo sides that region reaches
+uint8_t
+    haloSidesOf(const CloudRegion& region, const CloudDensityStorage& storage)
+{
+    // An emptied channel has a default region starting at 0, 0 that doesn't
+    // actually reach anything
+    if(region.isEmpty())
+        return 0;
+
+    uint8_t sides = 0;
+
+    if(region.startX == 0)
+        sides |= CLOUD_HALO_LEFT;
+    if(region.endX == storage.getPaddedWidth())
+        sides |= CLOUD_HALO_RIGHT;
+    if(region.startY == 0)
+        sides |= CLOUD_HALO_UP;
+    if(region.endY == storage.getPaddedHeight())
+        sides |= CLOUD_HALO_DOWN;
+
+    return sides;
+}
+
+//! \brief Maps the padded coordinates of one axis of a cloud to a coarse
+//! grid where factor cells of the interior are one cell
+//!
+//! The halo is one cell wide in both
+struct CoarseAxis {
+    size_t factor;
+
+    //! The size of the cloud without the halo
+    size_t size;
+
+    size_t
+        toCoarse(size_t x) const
+    {
+        if(x == 0)
+            return 0;
+
+        if(x > size)
+            return size / factor + 1;
+
+        return (x - 1) / factor + 1;
+    }
+
+    size_t
+        fineStart(size_t coarse) const
+    {
+        if(coarse == 0)
+            return 0;
+
+        if(coarse > size / factor)
+            return size + 1;
+
+        return (coarse - 1) * factor + 1;
+    }
+
+    size_t
+        fineEnd(size_t coarse) const
+    {
+        if(coarse == 0)
+            return 1;
+
+        if(coarse > size / factor)
+            return size + 2;
+
+        return coarse * factor + 1;
+    }
+};
+
+CloudRegion
+    toCoarse(
+        const CloudRegion& region, const CoarseAxis& x, const CoarseAxis& y)
+{
+    if(region.isEmpty())
+        return {};
+
+    return {x.toCoarse(region.startX), y.toCoarse(region.startY),
+        x.toCoarse(region.endX - 1) + 1, y.toCoarse(region.endY - 1) + 1};
+}
+
+CloudRegion
+    toFine(const CloudRegion& region, const CoarseAxis& x, const CoarseAxis& y)
+{
+    if(region.isEmpty())
+        return {};
+
+    return {x.fineStart(region.startX), y.fineStart(region.startY),
+        x.fineEnd(region.endX - 1), y.fineEnd(region.endY - 1)};
+}
+
+//! \brief Spreads the cells in area of coarse evenly over the blocks they
+//! cover in fine. The cells of fine that are written to need to be cleared
+void
+    spreadCoarseCells(ConstCloudDensityView coarse,
+        CloudDensityView fine,
+        const CloudRegion& area,
+        const CoarseAxis& xAxis,
+        const CoarseAxis& yAxis)
+{
+    for(size_t y = area.startY; y < area.endY; ++y) {
+        for(size_t x = area.startX; x < area.endX; ++x) {
+
+            const float value = coarse(x, y);
+
+            if(value == 0)
+                continue;
+
+            const size_t startX = xAxis.fineStart(x);
+            const size_t endX = xAxis.fineEnd(x);
+            const size_t startY = yAxis.fineStart(y);
+            const size_t endY = yAxis.fineEnd(y);
+
+            const float perCell = value / ((endX - startX) * (endY - startY));
+
+            for(size_t fineY = startY; fineY < endY; ++fineY) {
+                for(size_t fineX = startX; fineX < endX; ++fineX)
+                    fine(fineX, fineY) = perCell;
+            }
+        }
+    }
+}
+
+//! \returns How much of the difference between the cells on the two sides of
+//! an edge between clouds moves across it in one step
+//! \param a The diffusion rate multiplied by the time step
+float
+    edgeDiffusionRate(float a, size_t factor, size_t otherFactor)
+{
+    // Inside a cloud the diffusion moves a / 4 of the difference between two
+    // cells. The centers of the cells are further apart when either of the
+    // clouds is simulated at a lower resolution. This is limited so that a
+    // corner cell can't give away more than it has even with the long steps
+    // the implicit diffusion allows
+    return std::min(a / 2 / (factor + otherFactor), 0.25f);
+}
+
+//! \brief Undoes the change in the total amount that a diffusion sweep over
+//! area makes
+//!
+//! The sweep reads the already updated left and upper neighbours but the old
+//! right and lower ones. Inside area these cancel out, but the cells on the
+//! last column and row aren't read back as updated by anything, so the total
+//! changes by a / 4 / (1 - a / 2) of how much they changed. Only the halo
+//! around area is left to move things in or out. oldDens needs to have
+//! started from density in area for this to be exact
+//! \param a The diffusion rate multiplied by the time step
+void
+    balanceDiffusionSweep(CloudDensityView oldDens,
+        ConstCloudDensityView density,
+        const CloudRegion& area,
+        float a)
+{
+    if(area.isEmpty())
+        return;
+
+    const float scale = a / 4 / (1 - a / 2);
+
+    const size_t lastX = area.endX - 1;
+    const size_t lastY = area.endY - 1;
+
+    for(size_t y = area.startY; y < lastY; ++y)
+        oldDens(lastX, y) += (oldDens(lastX, y) - density(lastX, y)) * scale;
+
+    for(size_t x = area.startX; x < lastX; ++x)
+        oldDens(x, lastY) += (oldDens(x, lastY) - density(x, lastY)) * scale;
+
+    // The corner misses both of the neighbours
+    oldDens(lastX, lastY) +=
+        (oldDens(lastX, lastY) - density(lastX, lastY)) * scale * 2;
+}
+} // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
 // CompoundCloudComponent
@@ -55,29 +302,28 @@ CompoundCloudComponent::CompoundCloudComponent(CompoundCloudSystem& owner,
         m_compoundId4 = fourth->id;
         m_color4 = fourth->colour;
     }
+
+    const std::array<Compound*, CLOUDS_IN_ONE> compounds{
+        first, second, third, fourth};
+
+    for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
+        if(compounds[i]) {
+            m_channelParameters[i] = {compounds[i]->diffusionRate,
+                compounds[i]->viscosity, compounds[i]->implicitDiffusion};
+        }
+    }
 }
 
 CompoundCloudComponent::~CompoundCloudComponent()
 {
-    LEVIATHAN_ASSERT(
-        !m_sceneNode && !m_renderable, "CompoundCloudComponent not Released");
-
     m_owner.cloudReportDestroyed(this);
 }
 
 void
     CompoundCloudComponent::Release(bs::Scene* scene)
 {
-    if(m_sceneNode && !m_sceneNode.isDestroyed()) {
-
-        m_sceneNode->destroy();
-        m_sceneNode = nullptr;
-        m_renderable = nullptr;
-    }
-
+    // The graphics are owned by CompoundCloudSystem
     m_initialized = false;
-
-    // Other resources are held by smart pointers
 }
 
 // ------------------------------------ //
@@ -109,6 +355,18 @@ bool
         return true;
     return false;
 }
+
+CompoundId
+    CompoundCloudComponent::getCompoundIdForChannel(size_t channel) const
+{
+    switch(channel) {
+    case 0: return m_compoundId1;
+    case 1: return m_compoundId2;
+    case 2: return m_compoundId3;
+    case 3: return m_compoundId4;
+    default: return NULL_COMPOUND;
+    }
+}
 // ------------------------------------ //
 void
     CompoundCloudComponent::addCloud(CompoundId compound,
@@ -116,12 +374,21 @@ void
         size_t x,
         size_t y)
 {
-    switch(getSlotForCompound(compound)) {
-    case SLOT::FIRST: m_density1[x][y] += dens; break;
-    case SLOT::SECOND: m_density2[x][y] += dens; break;
-    case SLOT::THIRD: m_density3[x][y] += dens; break;
-    case SLOT::FOURTH: m_density4[x][y] += dens; break;
-    }
+    addCloudToChannel(
+        static_cast<size_t>(getSlotForCompound(compound)), dens, x, y);
+}
+
+void
+    CompoundCloudComponent::addCloudToChannel(size_t channel,
+        float dens,
+        size_t x,
+        size_t y)
+{
+    m_densities.getDensity(channel)(x, y) += dens;
+
+    // The active region is in padded coordinates
+    const size_t halo = m_densities.getHalo();
+    m_densities.getActiveRegion(channel).include(x + halo, y + halo);
 }
 
 int
@@ -130,72 +397,43 @@ int
         size_t y,
         float rate)
 {
-    switch(getSlotForCompound(compound)) {
-    case SLOT::FIRST: {
-        int amountToGive = static_cast<int>(m_density1[x][y] * rate);
-        m_density1[x][y] -= amountToGive;
-        if(m_density1[x][y] < 1)
-            m_density1[x][y] = 0;
-
-        return amountToGive;
-    }
-    case SLOT::SECOND: {
-        int amountToGive = static_cast<int>(m_density2[x][y] * rate);
-        m_density2[x][y] -= amountToGive;
-        if(m_density2[x][y] < 1)
-            m_density2[x][y] = 0;
+    return takeCompoundFromChannel(
+        static_cast<size_t>(getSlotForCompound(compound)), x, y, rate);
+}
 
-        return amountToGive;
-    }
-    case SLOT::THIRD: {
-        int amountToGive = static_cast<int>(m_density3[x][y] * rate);
-        m_density3[x][y] -= amountToGive;
-        if(m_density3[x][y] < 1)
-            m_density3[x][y] = 0;
+int
+    CompoundCloudComponent::amountAvailable(CompoundId compound,
+        size_t x,
+        size_t y,
+        float rate)
+{
+    return amountAvailableInChannel(
+        static_cast<size_t>(getSlotForCompound(compound)), x, y, rate);
+}
 
-        return amountToGive;
-    }
-    case SLOT::FOURTH: {
-        int amountToGive = static_cast<int>(m_density4[x][y] * rate);
-        m_density4[x][y] -= amountToGive;
-        if(m_density4[x][y] < 1)
-            m_density4[x][y] = 0;
+int
+    CompoundCloudComponent::takeCompoundFromChannel(size_t channel,
+        size_t x,
+        size_t y,
+        float rate)
+{
+    auto& density = m_densities.getDensity(channel)(x, y);
 
-        return amountToGive;
-    }
-    }
+    int amountToGive = static_cast<int>(density * rate);
+    density -= amountToGive;
+    if(density < 1)
+        density = 0;
 
-    LEVIATHAN_ASSERT(false, "Shouldn't get here");
-    return -1;
+    return amountToGive;
 }
 
 int
-    CompoundCloudComponent::amountAvailable(CompoundId compound,
+    CompoundCloudComponent::amountAvailableInChannel(size_t channel,
         size_t x,
         size_t y,
-        float rate)
+        float rate) const
 {
-    switch(getSlotForCompound(compound)) {
-    case SLOT::FIRST: {
-        int amountToGive = static_cast<int>(m_density1[x][y] * rate);
-        return amountToGive;
-    }
-    case SLOT::SECOND: {
-        int amountToGive = static_cast<int>(m_density2[x][y] * rate);
-        return amountToGive;
-    }
-    case SLOT::THIRD: {
-        int amountToGive = static_cast<int>(m_density3[x][y] * rate);
-        return amountToGive;
-    }
-    case SLOT::FOURTH: {
-        int amountToGive = static_cast<int>(m_density4[x][y] * rate);
-        return amountToGive;
-    }
-    }
-
-    LEVIATHAN_ASSERT(false, "Shouldn't get here");
-    return -1;
+    return static_cast<int>(m_densities.getDensity(channel)(x, y) * rate);
 }
 
 void
@@ -203,28 +441,16 @@ void
         size_t y,
         std::vector<std::tuple<CompoundId, float>>& result)
 {
-    if(m_compoundId1 != NULL_COMPOUND) {
-        const auto amount = m_density1[x][y];
-        if(amount > 0)
-            result.emplace_back(m_compoundId1, amount);
-    }
+    for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
 
-    if(m_compoundId2 != NULL_COMPOUND) {
-        const auto amount = m_density2[x][y];
-        if(amount > 0)
-            result.emplace_back(m_compoundId2, amount);
-    }
+        const auto id = getCompoundIdForChannel(i);
 
-    if(m_compoundId3 != NULL_COMPOUND) {
-        const auto amount = m_density3[x][y];
-        if(amount > 0)
-            result.emplace_back(m_compoundId3, amount);
-    }
+        if(id == NULL_COMPOUND)
+            continue;
 
-    if(m_compoundId4 != NULL_COMPOUND) {
-        const auto amount = m_density4[x][y];
+        const auto amount = m_densities.getDensity(i)(x, y);
         if(amount > 0)
-            result.emplace_back(m_compoundId4, amount);
+            result.emplace_back(id, amount);
     }
 }
 // ------------------------------------ //
@@ -233,53 +459,40 @@ void
 {
     m_position = newPosition;
 
-    // This check is for non-graphical mode
-    if(m_sceneNode)
-        m_sceneNode->setPosition(
-            bs::Vector3(m_position.X, CLOUD_Y_COORDINATE, m_position.Z));
-
     clearContents();
 }
 
 void
     CompoundCloudComponent::clearContents()
 {
-    // Clear data. Maybe there is a faster way
-    if(m_compoundId1 != NULL_COMPOUND) {
-        for(size_t x = 0; x < m_density1.size(); ++x) {
-            for(size_t y = 0; y < m_density1[x].size(); ++y) {
-                m_density1[x][y] = 0;
-                m_oldDens1[x][y] = 0;
-            }
-        }
-    }
+    // All the channels are in one buffer so this is just a memset
+    m_densities.clear();
+    m_haloSides.fill(0);
+}
 
-    if(m_compoundId2 != NULL_COMPOUND) {
-        for(size_t x = 0; x < m_density2.size(); ++x) {
-            for(size_t y = 0; y < m_density2[x].size(); ++y) {
-                m_density2[x][y] = 0;
-                m_oldDens2[x][y] = 0;
-            }
-        }
-    }
+CompoundCloudComponent*
+    CompoundCloudComponent::getNeighbour(int dx, int dy) const
+{
+    CompoundCloudComponent* const horizontal =
+        dx < 0 ? m_leftCloud : (dx > 0 ? m_rightCloud : nullptr);
 
-    if(m_compoundId3 != NULL_COMPOUND) {
-        for(size_t x = 0; x < m_density3.size(); ++x) {
-            for(size_t y = 0; y < m_density3[x].size(); ++y) {
-                m_density3[x][y] = 0;
-                m_oldDens3[x][y] = 0;
-            }
-        }
-    }
+    if(dy == 0)
+        return horizontal;
 
-    if(m_compoundId4 != NULL_COMPOUND) {
-        for(size_t x = 0; x < m_density4.size(); ++x) {
-            for(size_t y = 0; y < m_density4[x].size(); ++y) {
-                m_density4[x][y] = 0;
-                m_oldDens4[x][y] = 0;
-            }
-        }
-    }
+    CompoundCloudComponent* const vertical =
+        dy < 0 ? m_upperCloud : m_lowerCloud;
+
+    if(dx == 0)
+        return vertical;
+
+    // Diagonal ones are found through either of the side ones
+    if(horizontal)
+        return dy < 0 ? horizontal->m_upperCloud : horizontal->m_lowerCloud;
+
+    if(vertical)
+        return dx < 0 ? vertical->m_leftCloud : vertical->m_rightCloud;
+
+    return nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -293,17 +506,32 @@ void
     // field.
     // createVelocityField();
 
+    LOG_INFO(std::string("CompoundCloudSystem: using ") +
+             m_kernels.getISAName() + " cloud simulation kernels");
+
+    LOG_INFO(std::string("CompoundCloudSystem: using ") +
+             (m_textureFormat == CLOUD_TEXTURE_FORMAT::HALF_FLOAT ?
+                     "half float" :
+                     "8 bit") +
+             " cloud textures");
+
     // Skip if no graphics
     if(!Engine::Get()->IsInGraphicalMode())
         return;
 
+    // One plane draws the whole grid of one cloud group
     m_planeMesh = Leviathan::GeometryHelpers::CreateXZPlane(
-        CLOUD_X_EXTENT, CLOUD_Y_EXTENT);
+        CLOUD_X_EXTENT * 3, CLOUD_Y_EXTENT * 3);
 
     m_perlinNoise =
         Engine::Get()->GetGraphics()->LoadTextureByName("PerlinNoise.jpg");
 
     LEVIATHAN_ASSERT(m_perlinNoise, "failed to load perlin noise texture");
+
+    m_cloudShader =
+        Engine::Get()->GetGraphics()->LoadShaderByName("compound_cloud.bsl");
+
+    LEVIATHAN_ASSERT(m_cloudShader, "failed to load compound cloud shader");
 }
 
 void
@@ -317,16 +545,47 @@ void
         world.DestroyEntity(m_managedClouds.begin()->first);
     }
 
+    destroyGroupGraphics();
+
     m_planeMesh = nullptr;
     m_perlinNoise = nullptr;
+    m_cloudShader = nullptr;
 }
 // ------------------------------------ //
+void
+    CompoundCloudSystem::setTextureFormat(CLOUD_TEXTURE_FORMAT format)
+{
+    if(!m_managedClouds.empty()) {
+        LOG_ERROR("CompoundCloudSystem: texture format can't be changed after "
+                  "the clouds have been spawned");
+        return;
+    }
+
+    m_textureFormat = format;
+}
+
 void
     CompoundCloudSystem::registerCloudTypes(CellStageWorld& world,
         const std::vector<Compound>& clouds)
 {
     m_cloudTypes = clouds;
 
+    // The groups may now be different
+    m_tileCache.clear();
+    m_groupTimeAccumulators.clear();
+
+    m_compoundSlots.clear();
+
+    for(size_t i = 0; i < m_cloudTypes.size(); ++i) {
+
+        const CompoundId id = m_cloudTypes[i].id;
+
+        if(id >= m_compoundSlots.size())
+            m_compoundSlots.resize(id + 1, {NO_CLOUD_SLOT, 0});
+
+        m_compoundSlots[id] = {i / CLOUDS_IN_ONE, i % CLOUDS_IN_ONE};
+    }
+
     // We do a spawn cycle immediately to make sure that even early code can
     // spawn clouds
     doSpawnCycle(world, Float3(0, 0, 0));
@@ -338,34 +597,25 @@ bool
         const Float3& worldPosition)
 {
     // Find the target cloud //
-    for(auto& cloud : m_managedClouds) {
+    const auto [cloud, channel] = findCloudForCompound(compound, worldPosition);
 
-        const auto& pos = cloud.second->m_position;
-
-        if(cloudContainsPosition(pos, worldPosition)) {
-            // Within cloud
-
-            // Skip wrong types
-            if(!cloud.second->handlesCompound(compound))
-                continue;
+    if(!cloud)
+        return false;
 
-            try {
-                auto [x, y] = convertWorldToCloudLocal(pos, worldPosition);
-                cloud.second->addCloud(compound, density, x, y);
+    try {
+        auto [x, y] =
+            convertWorldToCloudLocal(cloud->m_position, worldPosition);
+        cloud->addCloudToChannel(channel, density, x, y);
 
-                return true;
+        return true;
 
-            } catch(const Leviathan::InvalidArgument& e) {
-                LOG_ERROR("CompoundCloudSystem: can't place cloud because the "
-                          "cloud math is "
-                          "wrong, exception:");
-                e.PrintToLog();
-                return false;
-            }
-        }
+    } catch(const Leviathan::InvalidArgument& e) {
+        LOG_ERROR("CompoundCloudSystem: can't place cloud because the "
+                  "cloud math is "
+                  "wrong, exception:");
+        e.PrintToLog();
+        return false;
     }
-
-    return false;
 }
 
 float
@@ -373,33 +623,23 @@ float
         const Float3& worldPosition,
         float rate)
 {
-    for(auto& cloud : m_managedClouds) {
+    const auto [cloud, channel] = findCloudForCompound(compound, worldPosition);
 
-        const auto& pos = cloud.second->m_position;
+    if(!cloud)
+        return 0;
 
-        if(cloudContainsPosition(pos, worldPosition)) {
-            // Within cloud
+    try {
+        auto [x, y] =
+            convertWorldToCloudLocal(cloud->m_position, worldPosition);
+        return cloud->takeCompoundFromChannel(channel, x, y, rate);
 
-            // Skip wrong types
-            if(!cloud.second->handlesCompound(compound))
-                continue;
-
-            try {
-                auto [x, y] = convertWorldToCloudLocal(pos, worldPosition);
-                return cloud.second->takeCompound(compound, x, y, rate);
-
-            } catch(const Leviathan::InvalidArgument& e) {
-                LOG_ERROR(
-                    "CompoundCloudSystem: can't take from cloud because the "
-                    "cloud math is "
-                    "wrong, exception:");
-                e.PrintToLog();
-                return false;
-            }
-        }
+    } catch(const Leviathan::InvalidArgument& e) {
+        LOG_ERROR("CompoundCloudSystem: can't take from cloud because the "
+                  "cloud math is "
+                  "wrong, exception:");
+        e.PrintToLog();
+        return false;
     }
-
-    return 0;
 }
 
 float
@@ -407,32 +647,22 @@ float
         const Float3& worldPosition,
         float rate)
 {
-    for(auto& cloud : m_managedClouds) {
+    const auto [cloud, channel] = findCloudForCompound(compound, worldPosition);
 
-        const auto& pos = cloud.second->m_position;
+    if(!cloud)
+        return 0;
 
-        if(cloudContainsPosition(pos, worldPosition)) {
-            // Within cloud
+    try {
+        auto [x, y] =
+            convertWorldToCloudLocal(cloud->m_position, worldPosition);
+        return cloud->amountAvailableInChannel(channel, x, y, rate);
 
-            // Skip wrong types
-            if(!cloud.second->handlesCompound(compound))
-                continue;
-
-            try {
-                auto [x, y] = convertWorldToCloudLocal(pos, worldPosition);
-                return cloud.second->amountAvailable(compound, x, y, rate);
-
-            } catch(const Leviathan::InvalidArgument& e) {
-                LOG_ERROR(
-                    "CompoundCloudSystem: can't get available compounds "
-                    "from cloud because the cloud math is wrong, exception:");
-                e.PrintToLog();
-                return false;
-            }
-        }
+    } catch(const Leviathan::InvalidArgument& e) {
+        LOG_ERROR("CompoundCloudSystem: can't get available compounds "
+                  "from cloud because the cloud math is wrong, exception:");
+        e.PrintToLog();
+        return false;
     }
-
-    return 0;
 }
 
 std::vector<std::tuple<CompoundId, float>>
@@ -440,28 +670,243 @@ std::vector<std::tuple<CompoundId, float>>
 {
     std::vector<std::tuple<CompoundId, float>> result;
 
-    for(auto& cloud : m_managedClouds) {
+    const int cell = findGridCell(worldPosition);
 
-        const auto& pos = cloud.second->m_position;
+    if(cell < 0)
+        return result;
 
-        if(cloudContainsPosition(pos, worldPosition)) {
-            // Within cloud
+    // All the groups have a cloud in each cell
+    const size_t groups = m_cloudIndex.size() / 9;
 
-            try {
-                auto [x, y] = convertWorldToCloudLocal(pos, worldPosition);
-                cloud.second->getCompoundsAt(x, y, result);
-
-            } catch(const Leviathan::InvalidArgument& e) {
-                LOG_ERROR(
-                    "CompoundCloudSystem: can't get available compounds "
-                    "from cloud because the cloud math is wrong, exception:");
-                e.PrintToLog();
-            }
+    for(size_t group = 0; group < groups; ++group) {
+
+        CompoundCloudComponent* cloud = m_cloudIndex[cell * groups + group];
+
+        if(!cloud)
+            continue;
+
+        try {
+            auto [x, y] =
+                convertWorldToCloudLocal(cloud->m_position, worldPosition);
+            cloud->getCompoundsAt(x, y, result);
+
+        } catch(const Leviathan::InvalidArgument& e) {
+            LOG_ERROR(
+                "CompoundCloudSystem: can't get available compounds "
+                "from cloud because the cloud math is wrong, exception:");
+            e.PrintToLog();
         }
     }
 
     return result;
 }
+
+size_t
+    CompoundCloudSystem::addClouds(const std::vector<CloudDeposit>& deposits)
+{
+    m_batchOperations.clear();
+
+    for(size_t i = 0; i < deposits.size(); ++i) {
+
+        const auto& deposit = deposits[i];
+
+        BatchOperation operation;
+        if(!findCloudCell(deposit.compound, deposit.position, operation.cloud,
+               operation.channel, operation.x, operation.y))
+            continue;
+
+        operation.value = deposit.amount;
+        operation.index = i;
+        m_batchOperations.push_back(operation);
+    }
+
+    sortBatchOperations();
+
+    for(const auto& operation : m_batchOperations) {
+        operation.cloud->addCloudToChannel(
+            operation.channel, operation.value, operation.x, operation.y);
+    }
+
+    return m_batchOperations.size();
+}
+
+void
+    CompoundCloudSystem::takeCompounds(const std::vector<CloudTake>& takes,
+        std::vector<float>& taken)
+{
+    taken.assign(takes.size(), 0);
+    m_batchOperations.clear();
+
+    for(size_t i = 0; i < takes.size(); ++i) {
+
+        const auto& take = takes[i];
+
+        BatchOperation operation;
+        if(!findCloudCell(take.compound, take.position, operation.cloud,
+               operation.channel, operation.x, operation.y))
+            continue;
+
+        operation.value = take.rate;
+        operation.index = i;
+        m_batchOperations.push_back(operation);
+    }
+
+    sortBatchOperations();
+
+    for(const auto& operation : m_batchOperations) {
+        taken[operation.index] = operation.cloud->takeCompoundFromChannel(
+            operation.channel, operation.x, operation.y, operation.value);
+    }
+}
+
+bool
+    CompoundCloudSystem::findCloudCell(CompoundId compound,
+        const Float3& worldPosition,
+        CompoundCloudComponent*& cloud,
+        size_t& channel,
+        size_t& x,
+        size_t& y) const
+{
+    std::tie(cloud, channel) = findCloudForCompound(compound, worldPosition);
+
+    if(!cloud)
+        return false;
+
+    // This is checked here instead of with the exception from
+    // convertWorldToCloudLocal as it is faster
+    const auto [localX, localY] =
+        convertWorldToCloudLocalForGrab(cloud->m_position, worldPosition);
+
+    if(localX < 0 || localY < 0 || localX >= CLOUD_SIMULATION_WIDTH ||
+        localY >= CLOUD_SIMULATION_HEIGHT)
+        return false;
+
+    x = static_cast<size_t>(localX);
+    y = static_cast<size_t>(localY);
+    return true;
+}
+
+void
+    CompoundCloudSystem::sortBatchOperations()
+{
+    // Stable so that operations on the same cell keep their order. Sorting by
+    // the rows as well makes the accesses go through memory in order
+    std::stable_sort(m_batchOperations.begin(), m_batchOperations.end(),
+        [](const BatchOperation& first, const BatchOperation& second) {
+            return std::tie(first.cloud, first.channel, first.y, first.x) <
+                   std::tie(second.cloud, second.channel, second.y, second.x);
+        });
+}
+
+std::tuple<CompoundCloudComponent*, size_t>
+    CompoundCloudSystem::findCloudForCompound(CompoundId compound,
+        const Float3& worldPosition) const
+{
+    if(compound >= m_compoundSlots.size())
+        return {nullptr, 0};
+
+    const auto [group, channel] = m_compoundSlots[compound];
+
+    if(group == NO_CLOUD_SLOT)
+        return {nullptr, 0};
+
+    const int cell = findGridCell(worldPosition);
+
+    if(cell < 0)
+        return {nullptr, 0};
+
+    const size_t index = cell * (m_cloudIndex.size() / 9) + group;
+
+    if(index >= m_cloudIndex.size())
+        return {nullptr, 0};
+
+    return {m_cloudIndex[index], channel};
+}
+
+int
+    CompoundCloudSystem::findGridCell(const Float3& worldPosition) const
+{
+    // Relative to the top left corner of the top left cloud
+    const Float3 topLeft = m_cloudGridCenter -
+                           Float3(CLOUD_WIDTH + CLOUD_X_EXTENT, 0,
+                               CLOUD_HEIGHT + CLOUD_Y_EXTENT);
+
+    const float relativeX = worldPosition.X - topLeft.X;
+    const float relativeZ = worldPosition.Z - topLeft.Z;
+
+    const int column =
+        static_cast<int>(std::floor(relativeX / CLOUD_X_EXTENT));
+    const int row = static_cast<int>(std::floor(relativeZ / CLOUD_Y_EXTENT));
+
+    if(column < 0 || column > 2 || row < 0 || row > 2)
+        return -1;
+
+    return GRID_ORDER[row * 3 + column];
+}
+
+void
+    CompoundCloudSystem::rebuildCloudIndex()
+{
+    const size_t groups =
+        (m_cloudTypes.size() + CLOUDS_IN_ONE - 1) / CLOUDS_IN_ONE;
+
+    m_cloudIndex.assign(groups * 9, nullptr);
+
+    for(const auto& [entity, cloud] : m_managedClouds) {
+
+        cloud->m_leftCloud = nullptr;
+        cloud->m_rightCloud = nullptr;
+        cloud->m_upperCloud = nullptr;
+        cloud->m_lowerCloud = nullptr;
+
+        const int cell = findGridCell(cloud->m_position);
+        const CompoundId firstCompound = cloud->getCompoundId1();
+
+        if(cell < 0 || firstCompound >= m_compoundSlots.size()) {
+            LOG_ERROR("CompoundCloudSystem: cloud is not at a grid position "
+                      "or has an unknown compound, can't index it");
+            continue;
+        }
+
+        const size_t group = std::get<0>(m_compoundSlots[firstCompound]);
+        m_cloudIndex[cell * groups + group] = cloud;
+    }
+
+    // Link up the clouds that have the same compounds for the halo exchange
+    const auto cloudAt = [&](int row, int column,
+                             size_t group) -> CompoundCloudComponent* {
+        if(row < 0 || row > 2 || column < 0 || column > 2)
+            return nullptr;
+
+        return m_cloudIndex[GRID_ORDER[row * 3 + column] * groups + group];
+    };
+
+    for(int row = 0; row < 3; ++row) {
+        for(int column = 0; column < 3; ++column) {
+            for(size_t group = 0; group < groups; ++group) {
+
+                CompoundCloudComponent* cloud = cloudAt(row, column, group);
+
+                if(!cloud)
+                    continue;
+
+                cloud->m_leftCloud = cloudAt(row, column - 1, group);
+                cloud->m_rightCloud = cloudAt(row, column + 1, group);
+                cloud->m_upperCloud = cloudAt(row - 1, column, group);
+                cloud->m_lowerCloud = cloudAt(row + 1, column, group);
+
+                // Only the center is simulated at full resolution
+                if(row == 1 && column == 1) {
+                    cloud->m_lodFactor = 1;
+                } else if(row == 1 || column == 1) {
+                    cloud->m_lodFactor = CLOUD_EDGE_LOD_FACTOR;
+                } else {
+                    cloud->m_lodFactor = CLOUD_CORNER_LOD_FACTOR;
+                }
+            }
+        }
+    }
+}
 // ------------------------------------ //
 void
     CompoundCloudSystem::emptyAllClouds()
@@ -469,6 +914,8 @@ void
     for(auto& cloud : m_managedClouds) {
         cloud.second->clearContents();
     }
+
+    m_tileCache.clear();
 }
 // ------------------------------------ //
 bool
@@ -535,62 +982,220 @@ std::tuple<float, float>
     return std::make_tuple(localX, localY);
 }
 
-Float3
-    CompoundCloudSystem::calculateGridCenterForPlayerPos(const Float3& pos)
+Float3
+    CompoundCloudSystem::calculateGridCenterForPlayerPos(const Float3& pos)
+{
+    // The gaps between the positions is used for calculations here. Otherwise
+    // all clouds get moved when the player moves
+    return Float3(
+        static_cast<int>(std::round(pos.X / CLOUD_X_EXTENT)) * CLOUD_X_EXTENT,
+        0,
+        static_cast<int>(std::round(pos.Z / CLOUD_Y_EXTENT)) * CLOUD_Y_EXTENT);
+}
+
+// ------------------------------------ //
+void
+    CompoundCloudSystem::Run(CellStageWorld& world, float elapsed)
+{
+    if(!world.GetNetworkSettings().IsAuthoritative)
+        return;
+
+    Float3 position = Float3(0, 0, 0);
+
+    // Hybrid client-server version
+    if(ThriveGame::Get()) {
+
+        auto playerEntity = ThriveGame::Get()->playerData().activeCreature();
+
+        if(playerEntity == NULL_OBJECT) {
+
+            LOG_WARNING(
+                "CompoundCloudSystem: Run: playerData().activeCreature() "
+                "is NULL_OBJECT. "
+                "Using default position");
+        } else {
+
+            try {
+                // Get the player's position.
+                const Leviathan::Position& posEntity =
+                    world.GetComponent_Position(playerEntity);
+                position = posEntity.Members._Position;
+
+            } catch(const Leviathan::NotFound&) {
+                LOG_WARNING("CompoundCloudSystem: Run: playerEntity(" +
+                            std::to_string(playerEntity) + ") has no position");
+            }
+        }
+    }
+
+    doSpawnCycle(world, position);
+
+    scheduleGroupSteps(elapsed);
+
+    // A step replaces the older texture so after it both textures are in the
+    // current layout
+    for(size_t group : m_steppedGroups) {
+        if(group < m_groupGraphics.size())
+            m_groupGraphics[group].showLatestOnly = false;
+    }
+
+    // The interpolation needs to be updated every tick even when nothing is
+    // simulated
+    for(size_t group = 0; group < m_groupGraphics.size(); ++group) {
+
+        CloudGroupGraphics& graphics = m_groupGraphics[group];
+
+        const float interpolation =
+            graphics.showLatestOnly ?
+                1.f :
+                std::clamp(
+                    m_groupTimeAccumulators[group] / m_simulationInterval, 0.f,
+                    1.f);
+
+        graphics.material->setFloat("gInterpolation", interpolation);
+    }
+
+    if(m_steppedGroups.empty())
+        return;
+
+    FluidSystem& fluidSystem = world.GetFluidSystem();
+
+    // The fluid velocity for all the cloud cells is calculated once for the
+    // step here. FluidSystem doesn't calculate it on the ticks without cloud
+    // steps. The extra sample on each axis is for interpolating between the
+    // last cells
+    fluidSystem.updateVelocityField(
+        Float2(m_cloudGridCenter.X - CLOUD_WIDTH - CLOUD_X_EXTENT,
+            m_cloudGridCenter.Z - CLOUD_HEIGHT - CLOUD_Y_EXTENT),
+        CLOUD_SIMULATION_WIDTH * 3 + 1, CLOUD_SIMULATION_HEIGHT * 3 + 1,
+        CLOUD_RESOLUTION);
+
+    // Always the same step so that the clouds behave the same however fast
+    // the world ticks
+    const float step = m_simulationInterval;
+
+    // The groups don't share anything so only the clouds of the stepped ones
+    // are touched. The edges touch two clouds at once so they are done here
+    // before the clouds are simulated in parallel
+    const size_t groups = m_groupTimeAccumulators.size();
+
+    for(size_t group : m_steppedGroups) {
+        for(size_t cell = 0; cell < 9; ++cell) {
+
+            CompoundCloudComponent* cloud = m_cloudIndex[cell * groups + group];
+
+            if(!cloud)
+                continue;
+
+            for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
+                if(cloud->getCompoundIdForChannel(i) != NULL_COMPOUND)
+                    diffuseCloudEdges(*cloud, i, step);
+            }
+        }
+    }
+
+    // Each channel of each cloud only touches its own data (and the halos of
+    // the neighbours in separate steps) so they can all be simulated in
+    // parallel
+    m_simulationWork.clear();
+    m_haloWork.clear();
+
+    for(size_t group : m_steppedGroups) {
+        for(size_t cell = 0; cell < 9; ++cell) {
+
+            CompoundCloudComponent* cloud = m_cloudIndex[cell * groups + group];
+
+            if(!cloud)
+                continue;
+
+            if(!cloud->m_initialized) {
+                LEVIATHAN_ASSERT(false, "CompoundCloudSystem spawned a cloud "
+                                        "that it didn't initialize");
+            }
+
+            for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
+
+                if(cloud->getCompoundIdForChannel(i) == NULL_COMPOUND)
+                    continue;
+
+                // Empty channels don't need to be simulated but the
+                // neighbours might move something into them
+                if(!cloud->m_densities.getActiveRegion(i).isEmpty())
+                    m_simulationWork.emplace_back(cloud, i);
+
+                m_haloWork.emplace_back(cloud, i);
+            }
+        }
+    }
+
+    ThreadPool& pool = ThreadPool::getShared();
+
+    // These return only once all the work is done. The compounds moved to
+    // the halos can be collected only after all the neighbours have been
+    // simulated
+    pool.parallelFor(m_simulationWork.size(), [&](size_t index) {
+        const auto [cloud, channel] = m_simulationWork[index];
+        simulateCloudChannel(*cloud, channel, step, fluidSystem);
+    });
+
+    pool.parallelFor(m_haloWork.size(), [&](size_t index) {
+        const auto [cloud, channel] = m_haloWork[index];
+        collectCloudHalo(*cloud, channel);
+    });
+
+    // The texture uploads need to happen on the main thread
+    if(!m_groupGraphics.empty()) {
+        for(size_t group : m_steppedGroups)
+            uploadGroupTexture(group);
+    }
+}
+
+void
+    CompoundCloudSystem::setSimulationRate(float stepsPerSecond)
 {
-    // The gaps between the positions is used for calculations here. Otherwise
-    // all clouds get moved when the player moves
-    return Float3(
-        static_cast<int>(std::round(pos.X / CLOUD_X_EXTENT)) * CLOUD_X_EXTENT,
-        0,
-        static_cast<int>(std::round(pos.Z / CLOUD_Y_EXTENT)) * CLOUD_Y_EXTENT);
+    m_simulationInterval = 1 / std::clamp(stepsPerSecond,
+                                   MIN_CLOUD_SIMULATION_RATE,
+                                   MAX_CLOUD_SIMULATION_RATE);
 }
 
-// ------------------------------------ //
 void
-    CompoundCloudSystem::Run(CellStageWorld& world, float elapsed)
+    CompoundCloudSystem::scheduleGroupSteps(float elapsed)
 {
-    if(!world.GetNetworkSettings().IsAuthoritative)
-        return;
-
-    Float3 position = Float3(0, 0, 0);
-
-    // Hybrid client-server version
-    if(ThriveGame::Get()) {
-
-        auto playerEntity = ThriveGame::Get()->playerData().activeCreature();
-
-        if(playerEntity == NULL_OBJECT) {
-
-            LOG_WARNING(
-                "CompoundCloudSystem: Run: playerData().activeCreature() "
-                "is NULL_OBJECT. "
-                "Using default position");
-        } else {
+    const size_t groups =
+        (m_cloudTypes.size() + CLOUDS_IN_ONE - 1) / CLOUDS_IN_ONE;
 
-            try {
-                // Get the player's position.
-                const Leviathan::Position& posEntity =
-                    world.GetComponent_Position(playerEntity);
-                position = posEntity.Members._Position;
+    // The groups start at different points of their step so that they are
+    // simulated on different ticks
+    if(m_groupTimeAccumulators.size() != groups) {
+        m_groupTimeAccumulators.resize(groups);
 
-            } catch(const Leviathan::NotFound&) {
-                LOG_WARNING("CompoundCloudSystem: Run: playerEntity(" +
-                            std::to_string(playerEntity) + ") has no position");
-            }
+        for(size_t group = 0; group < groups; ++group) {
+            m_groupTimeAccumulators[group] =
+                m_simulationInterval * group / groups;
         }
     }
 
-    doSpawnCycle(world, position);
+    m_steppedGroups.clear();
+
+    for(size_t group = 0; group < groups; ++group) {
+
+        float& accumulator = m_groupTimeAccumulators[group];
+        accumulator += elapsed;
 
-    for(auto& value : m_managedClouds) {
+        if(accumulator < m_simulationInterval)
+            continue;
 
-        if(!value.second->m_initialized) {
-            LEVIATHAN_ASSERT(false, "CompoundCloudSystem spawned a cloud that "
-                                    "it didn't initialize");
+        // At most one step per tick. If the game is this far behind it is
+        // better to slow the clouds down than to make the ticks longer
+        if(accumulator >= m_simulationInterval * CLOUD_MAX_STEP_BACKLOG) {
+            const float dropped =
+                std::floor(accumulator / m_simulationInterval) - 1;
+            m_droppedSimulationSteps += static_cast<uint64_t>(dropped);
+            accumulator -= dropped * m_simulationInterval;
         }
 
-        processCloud(*value.second, elapsed, world.GetFluidSystem());
+        accumulator -= m_simulationInterval;
+        m_steppedGroups.push_back(group);
     }
 }
 
@@ -613,6 +1218,12 @@ void
                 _spawnCloud(world, pos, i);
             }
         }
+
+        rebuildCloudIndex();
+
+        // Skip if no graphics
+        if(Engine::Get()->IsInGraphicalMode())
+            createGroupGraphics(world.GetScene());
     }
     // This rounds up to the nearest multiple of 4,
     // divides that by 4 and multiplies by 9 to get all the clouds we have
@@ -636,6 +1247,22 @@ void
 
         m_cloudGridCenter = targetCenter;
         applyNewCloudPositioning();
+
+        // The clouds are now in different tiles of the atlases so both of
+        // the textures are uploaded again before the planes are drawn at the
+        // new position. Otherwise the interpolation would mix in the old
+        // layout until the next step of the group
+        for(size_t group = 0; group < m_groupGraphics.size(); ++group) {
+
+            CloudGroupGraphics& graphics = m_groupGraphics[group];
+
+            graphics.sceneNode->setPosition(bs::Vector3(
+                m_cloudGridCenter.X, CLOUD_Y_COORDINATE, m_cloudGridCenter.Z));
+
+            uploadBothGroupTextures(group);
+
+            graphics.showLatestOnly = true;
+        }
     }
 }
 
@@ -741,8 +1368,18 @@ void
                         groupType) {
 
                     // Found a candidate
-                    m_tooFarAwayClouds[checkReposition]->recycleToPosition(
-                        requiredPos);
+                    CompoundCloudComponent* cloud =
+                        m_tooFarAwayClouds[checkReposition];
+
+                    // The contents are kept for when the player comes back
+                    m_tileCache.store(
+                        getTileKey(cloud->m_position, groupType),
+                        cloud->m_densities);
+
+                    cloud->recycleToPosition(requiredPos);
+
+                    m_tileCache.restore(
+                        getTileKey(requiredPos, groupType), cloud->m_densities);
 
                     // Set to null to skip on next scan
                     m_tooFarAwayClouds[checkReposition] = nullptr;
@@ -770,6 +1407,16 @@ void
                 "clouds, a cloud that should have been moved wasn't moved");
         }
     }
+
+    rebuildCloudIndex();
+}
+
+CloudTileKey
+    CompoundCloudSystem::getTileKey(const Float3& position, CompoundId group)
+{
+    // The clouds are always at multiples of the extents
+    return {static_cast<int>(std::lround(position.X / CLOUD_X_EXTENT)),
+        static_cast<int>(std::lround(position.Z / CLOUD_Y_EXTENT)), group};
 }
 
 void
@@ -800,94 +1447,116 @@ void
     // TODO: this should probably be made a constructor parameter
     cloud.m_position = pos;
 
-    initializeCloud(cloud, world.GetScene());
+    initializeCloud(cloud);
 }
 
 
 void
-    CompoundCloudSystem::initializeCloud(CompoundCloudComponent& cloud,
-        bs::Scene* scene)
+    CompoundCloudSystem::initializeCloud(CompoundCloudComponent& cloud)
 {
     // All the densities
-    if(cloud.m_compoundId1 != NULL_COMPOUND) {
-        cloud.m_density1.resize(CLOUD_SIMULATION_WIDTH,
-            std::vector<float>(CLOUD_SIMULATION_HEIGHT, 0));
-        cloud.m_oldDens1.resize(CLOUD_SIMULATION_WIDTH,
-            std::vector<float>(CLOUD_SIMULATION_HEIGHT, 0));
-    }
-    if(cloud.m_compoundId2 != NULL_COMPOUND) {
-        cloud.m_density2.resize(CLOUD_SIMULATION_WIDTH,
-            std::vector<float>(CLOUD_SIMULATION_HEIGHT, 0));
-        cloud.m_oldDens2.resize(CLOUD_SIMULATION_WIDTH,
-            std::vector<float>(CLOUD_SIMULATION_HEIGHT, 0));
-    }
-    if(cloud.m_compoundId3 != NULL_COMPOUND) {
-        cloud.m_density3.resize(CLOUD_SIMULATION_WIDTH,
-            std::vector<float>(CLOUD_SIMULATION_HEIGHT, 0));
-        cloud.m_oldDens3.resize(CLOUD_SIMULATION_WIDTH,
-            std::vector<float>(CLOUD_SIMULATION_HEIGHT, 0));
-    }
-    if(cloud.m_compoundId4 != NULL_COMPOUND) {
-        cloud.m_density4.resize(CLOUD_SIMULATION_WIDTH,
-            std::vector<float>(CLOUD_SIMULATION_HEIGHT, 0));
-        cloud.m_oldDens4.resize(CLOUD_SIMULATION_WIDTH,
-            std::vector<float>(CLOUD_SIMULATION_HEIGHT, 0));
-    }
+    cloud.m_densities.allocate(
+        CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT, CLOUD_HALO);
 
     cloud.m_initialized = true;
+}
 
-    // Skip if no graphics
-    if(!Engine::Get()->IsInGraphicalMode())
-        return;
+void
+    CompoundCloudSystem::createGroupGraphics(bs::Scene* scene)
+{
+    destroyGroupGraphics();
 
-    cloud.m_sceneNode = bs::SceneObject::create("cloud");
+    const bs::PixelFormat pixelFormat = getPixelFormat(m_textureFormat);
 
-    cloud.m_renderable = cloud.m_sceneNode->addComponent<bs::CRenderable>();
-    cloud.m_renderable->setLayer(1 << *scene);
-    cloud.m_renderable->setMesh(m_planeMesh);
+    LEVIATHAN_ASSERT(bs::PixelUtil::getNumElemBytes(pixelFormat) ==
+                         getTexelBytes(m_textureFormat),
+        "Pixel format bytes has changed");
 
+    m_groupGraphics.resize(
+        (m_cloudTypes.size() + CLOUDS_IN_ONE - 1) / CLOUDS_IN_ONE);
 
-    // Set initial position
-    cloud.m_sceneNode->setPosition(bs::Vector3(
-        cloud.m_position.X, CLOUD_Y_COORDINATE, cloud.m_position.Z));
+    for(size_t group = 0; group < m_groupGraphics.size(); ++group) {
 
-    cloud.m_textureData1 = bs::PixelData::create(
-        CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT, 1, BS_PIXEL_FORMAT);
+        CloudGroupGraphics& graphics = m_groupGraphics[group];
 
-    LEVIATHAN_ASSERT(bs::PixelUtil::getNumElemBytes(BS_PIXEL_FORMAT) ==
-                         CLOUD_TEXTURE_BYTES_PER_ELEMENT,
-        "Pixel format bytes has changed");
+        graphics.sceneNode = bs::SceneObject::create("cloud group");
 
-    // Fill with zeroes
-    std::memset(static_cast<uint8_t*>(cloud.m_textureData1->getData()), 0,
-        cloud.m_textureData1->getSize());
+        graphics.renderable =
+            graphics.sceneNode->addComponent<bs::CRenderable>();
+        graphics.renderable->setLayer(1 << *scene);
+        graphics.renderable->setMesh(m_planeMesh);
 
-    // cloud.m_renderable->setCastShadows(false);
+        // The plane is at the center of the grid
+        graphics.sceneNode->setPosition(bs::Vector3(
+            m_cloudGridCenter.X, CLOUD_Y_COORDINATE, m_cloudGridCenter.Z));
 
-    // cloud.m_compoundCloudsPlane->setRenderQueueGroup(2);
+        for(size_t i = 0; i < CLOUD_TEXTURE_BUFFERS; ++i) {
+            auto& data = graphics.textureData[i];
 
-    cloud.m_texture = bs::Texture::create(cloud.m_textureData1, bs::TU_DYNAMIC);
+            data = bs::PixelData::create(
+                CLOUD_ATLAS_WIDTH, CLOUD_ATLAS_HEIGHT, 1, pixelFormat);
 
-    // TODO: this should be loaded just once to be more efficient
-    auto shader =
-        Engine::Get()->GetGraphics()->LoadShaderByName("compound_cloud.bsl");
+            // Fill with zeroes
+            std::memset(
+                static_cast<uint8_t*>(data->getData()), 0, data->getSize());
+        }
+
+        for(auto& texture : graphics.textures) {
+            texture =
+                bs::Texture::create(graphics.textureData[0], bs::TU_DYNAMIC);
+        }
 
-    bs::HMaterial material = bs::Material::create(shader);
-    material->setTexture("gDensityTex", cloud.m_texture);
+        graphics.material = bs::Material::create(m_cloudShader);
+        graphics.material->setTexture("gDensityTex", graphics.textures[0]);
+        graphics.material->setTexture("gPrevDensityTex", graphics.textures[1]);
+        graphics.material->setFloat("gInterpolation", 1.f);
+
+        // Set colour parameters. The unused channels have alpha 0 //
+        const auto colour = [&](size_t channel) {
+            const size_t index = group * CLOUDS_IN_ONE + channel;
+            return index < m_cloudTypes.size() ? m_cloudTypes[index].colour :
+                                                 Float4(0, 0, 0, 0);
+        };
+
+        graphics.material->setVec4("gCloudColour1", colour(0));
+        graphics.material->setVec4("gCloudColour2", colour(1));
+        graphics.material->setVec4("gCloudColour3", colour(2));
+        graphics.material->setVec4("gCloudColour4", colour(3));
+
+        // The perlin noise texture needs to be tileable. It is repeated once
+        // per cloud
+        graphics.material->setTexture("gNoiseTex", m_perlinNoise);
+        graphics.material->setFloat("gNoiseScale", 3.f);
+
+        // The half float textures have the plain densities
+        graphics.material->setFloat("gRawDensities",
+            m_textureFormat == CLOUD_TEXTURE_FORMAT::HALF_FLOAT ? 1.f : 0.f);
+
+        graphics.renderable->setMaterial(graphics.material);
+    }
+}
 
-    // Set colour parameters //
-    material->setVec4("gCloudColour1", cloud.m_color1);
-    material->setVec4("gCloudColour2", cloud.m_color2);
-    material->setVec4("gCloudColour3", cloud.m_color3);
-    material->setVec4("gCloudColour4", cloud.m_color4);
+void
+    CompoundCloudSystem::swapGroupTextures(CloudGroupGraphics& graphics)
+{
+    const size_t previous = graphics.currentTexture;
+    graphics.currentTexture = 1 - previous;
 
-    // The perlin noise texture needs to be tileable. We can't do tricks with
-    // the cloud's position
-    material->setTexture("gNoiseTex", m_perlinNoise);
+    graphics.material->setTexture(
+        "gDensityTex", graphics.textures[graphics.currentTexture]);
+    graphics.material->setTexture(
+        "gPrevDensityTex", graphics.textures[previous]);
+}
 
-    cloud.m_renderable->setMaterial(material);
+void
+    CompoundCloudSystem::destroyGroupGraphics()
+{
+    for(auto& graphics : m_groupGraphics) {
+        if(graphics.sceneNode && !graphics.sceneNode.isDestroyed())
+            graphics.sceneNode->destroy();
+    }
 
-    // cloud.m_planeMaterial->setReceiveShadows(false);
+    m_groupGraphics.clear();
 }
 // ------------------------------------ //
 void
@@ -898,6 +1567,11 @@ void
 
         if(iter->second == cloud) {
             m_managedClouds.erase(iter);
+            rebuildCloudIndex();
+
+            // Nothing left to draw
+            if(m_managedClouds.empty())
+                destroyGroupGraphics();
             return;
         }
     }
@@ -907,57 +1581,452 @@ void
 }
 // ------------------------------------ //
 void
-    CompoundCloudSystem::processCloud(CompoundCloudComponent& cloud,
+    CompoundCloudSystem::simulateCloudChannel(CompoundCloudComponent& cloud,
+        size_t channel,
         float elapsed,
-        FluidSystem& fluidSystem)
+        FluidSystem& fluidSystem) const
 {
-    elapsed *= 100.f;
-    Float2 pos(cloud.m_position.X, cloud.m_position.Z);
+    CloudRegion& region = cloud.m_densities.getActiveRegion(channel);
+
+    if(region.isEmpty())
+        return;
+
+    prepareCloudHalo(cloud, channel);
+
+    if(cloud.m_lodFactor > 1) {
+        simulateCoarseCloudChannel(cloud, channel, elapsed, fluidSystem);
+        return;
+    }
+
+    CloudDensityStorage& storage = cloud.m_densities;
 
-    // The diffusion rate seems to have a bigger effect
+    elapsed *= 100.f;
+    const Float2 topLeft(
+        cloud.m_position.X - CLOUD_WIDTH - CLOUD_HALO * CLOUD_RESOLUTION,
+        cloud.m_position.Z - CLOUD_HEIGHT - CLOUD_HALO * CLOUD_RESOLUTION);
+
+    // The halo mirrors the edges (see prepareCloudHalo), the neighbouring
+    // clouds exchange compounds in diffuseCloudEdges
+    const CloudDensityView density = storage.getPaddedDensity(channel);
+    const CloudDensityView oldDens = storage.getPaddedOldDensity(channel);
+
+    const CloudRegion diffused = getDiffusedRegion(cloud, channel);
+
+    const auto& parameters = cloud.m_channelParameters[channel];
+
+    // The sweep reads the neighbours it hasn't updated yet from oldDens, also
+    // the ones just outside diffused. Starting from the current densities
+    // keeps the amounts the same even when something was just added or moved
+    // in from a neighbour, and clears what is left from when this cloud was
+    // simulated at a lower resolution
+    const CloudRegion seeded =
+        diffused
+            .expanded(1, storage.getPaddedWidth(), storage.getPaddedHeight())
+            .intersected(storage.getInterior());
+
+    for(size_t y = seeded.startY; y < seeded.endY; ++y) {
+        for(size_t x = seeded.startX; x < seeded.endX; ++x)
+            oldDens(x, y) = density(x, y);
+    }
 
     // Compound clouds move from area of high concentration to area of low.
-    if(cloud.m_compoundId1 != NULL_COMPOUND) {
-        diffuse(0.007f, cloud.m_oldDens1, cloud.m_density1, elapsed);
-        // Move the compound clouds about the velocity field.
-        advect(cloud.m_oldDens1, cloud.m_density1, elapsed, fluidSystem, pos);
+    diffuse(parameters.diffusionRate, oldDens, density, elapsed, diffused,
+        parameters.implicitDiffusion);
+
+    if(!parameters.implicitDiffusion) {
+        balanceDiffusionSweep(
+            oldDens, density, diffused, parameters.diffusionRate * elapsed);
+    }
+
+    const CloudRegion occupied = CloudSimulationKernels::trimToOccupied(
+        oldDens, diffused, CLOUD_EMPTY_THRESHOLD);
+
+    // Everything in density is replaced by advect. Only the active region
+    // can have something in it
+    density.clear(region);
+
+    // Move the compounds about the velocity field. oldDens now only has
+    // something in occupied, so the moved region contains everything
+    region = advect(oldDens, density, elapsed, fluidSystem, topLeft, occupied,
+        parameters.viscosity);
+
+    // Anything moved into the halo is collected by collectCloudHalo
+    cloud.m_haloSides[channel] = haloSidesOf(region, storage);
+}
+
+void
+    CompoundCloudSystem::simulateCoarseCloudChannel(
+        CompoundCloudComponent& cloud,
+        size_t channel,
+        float elapsed,
+        FluidSystem& fluidSystem) const
+{
+    CloudDensityStorage& storage = cloud.m_densities;
+    CloudRegion& region = storage.getActiveRegion(channel);
+
+    elapsed *= 100.f;
+
+    const size_t factor = cloud.m_lodFactor;
+    const CoarseAxis xAxis{factor, storage.getWidth()};
+    const CoarseAxis yAxis{factor, storage.getHeight()};
+
+    const size_t width = storage.getWidth() / factor;
+    const size_t height = storage.getHeight() / factor;
+
+    // The channels are simulated on multiple threads at once so each thread
+    // has its own coarse grid. It is allocated for the largest size needed
+    // and the smaller ones use the start of it
+    thread_local CloudDensityStorage coarse;
+
+    if(coarse.getWidth() < width || coarse.getHeight() < height)
+        coarse.allocate(width, height, CLOUD_HALO);
+
+    const CloudDensityView coarseDensity(coarse.getPaddedDensity(0).data(),
+        width + 2 * CLOUD_HALO, height + 2 * CLOUD_HALO,
+        coarse.getPaddedWidth());
+    const CloudDensityView coarseOld(coarse.getPaddedOldDensity(0).data(),
+        width + 2 * CLOUD_HALO, height + 2 * CLOUD_HALO,
+        coarse.getPaddedWidth());
+
+    coarseDensity.clear();
+    coarseOld.clear();
+
+    const CloudDensityView density = storage.getPaddedDensity(channel);
+
+    // The blocks are summed so that the amounts stay the same. The halo of
+    // density has already been collected by the neighbours
+    const CloudRegion inside = region.intersected(storage.getInterior());
+
+    for(size_t y = inside.startY; y < inside.endY; ++y) {
+        for(size_t x = inside.startX; x < inside.endX; ++x) {
+            coarseDensity(xAxis.toCoarse(x), yAxis.toCoarse(y)) +=
+                density(x, y);
+        }
+    }
+
+    // The diffusion reads the neighbours it hasn't updated yet from the old
+    // densities. Starting from the current ones keeps the amounts the same
+    const CloudRegion coarseInside = toCoarse(inside, xAxis, yAxis);
+
+    for(size_t y = coarseInside.startY; y < coarseInside.endY; ++y) {
+        for(size_t x = coarseInside.startX; x < coarseInside.endX; ++x)
+            coarseOld(x, y) = coarseDensity(x, y);
+    }
+
+    // The edges with the neighbouring clouds are handled by
+    // diffuseCloudEdges so the halo mirrors the edges of this cloud
+    for(size_t x = 1; x <= width; ++x) {
+        coarseOld(x, 0) = coarseDensity(x, 1);
+        coarseOld(x, height + 1) = coarseDensity(x, height);
+    }
+
+    for(size_t y = 1; y <= height; ++y) {
+        coarseOld(0, y) = coarseDensity(1, y);
+        coarseOld(width + 1, y) = coarseDensity(width, y);
+    }
+
+    const auto& parameters = cloud.m_channelParameters[channel];
+    const float blockCells = static_cast<float>(factor * factor);
+
+    const CloudRegion area =
+        toCoarse(getDiffusedRegion(cloud, channel), xAxis, yAxis);
+
+    // The rates are per cell so they are scaled to move things as far in the
+    // world as at full resolution
+    diffuse(parameters.diffusionRate / blockCells, coarseOld, coarseDensity,
+        elapsed, area, parameters.implicitDiffusion);
+
+    if(!parameters.implicitDiffusion) {
+        balanceDiffusionSweep(coarseOld, coarseDensity, area,
+            parameters.diffusionRate / blockCells * elapsed);
+    }
+
+    const CloudRegion occupied = CloudSimulationKernels::trimToOccupied(
+        coarseOld, area, CLOUD_EMPTY_THRESHOLD * blockCells);
+
+    coarseDensity.clear();
+
+    // The coarse cells are sampled at the center of their blocks
+    const float cellSize = CLOUD_RESOLUTION * static_cast<float>(factor);
+    const float offset =
+        CLOUD_HALO * CLOUD_RESOLUTION + (cellSize - CLOUD_RESOLUTION) / 2;
+
+    const Float2 topLeft(cloud.m_position.X - CLOUD_WIDTH - offset,
+        cloud.m_position.Z - CLOUD_HEIGHT - offset);
+
+    const CloudRegion moved =
+        advect(coarseOld, coarseDensity, elapsed, fluidSystem, topLeft,
+            occupied, parameters.viscosity / factor, cellSize);
+
+    density.clear(region);
+    spreadCoarseCells(coarseDensity, density, moved, xAxis, yAxis);
+
+    region = toFine(moved, xAxis, yAxis);
+
+    // Anything moved into the halo is collected by collectCloudHalo
+    cloud.m_haloSides[channel] = haloSidesOf(region, storage);
+}
+
+void
+    CompoundCloudSystem::diffuseCloudEdges(CompoundCloudComponent& cloud,
+        size_t channel,
+        float elapsed)
+{
+    CloudDensityStorage& storage = cloud.m_densities;
+    const size_t width = storage.getWidth();
+    const size_t height = storage.getHeight();
+
+    const CloudDensityView density = storage.getPaddedDensity(channel);
+    CloudRegion& region = storage.getActiveRegion(channel);
+
+    // Same as what simulateCloudChannel uses
+    const float a =
+        elapsed * 100.f * cloud.m_channelParameters[channel].diffusionRate;
+
+    // Only the right and lower edges are done here so that each edge is done
+    // once. The amount moved across is calculated once for each pair of cells
+    // and what one side loses the other gains
+    if(CompoundCloudComponent* const right = cloud.m_rightCloud) {
+
+        const CloudDensityView other =
+            right->m_densities.getPaddedDensity(channel);
+        CloudRegion& otherRegion = right->m_densities.getActiveRegion(channel);
+
+        // The rows that have something on either side of the edge
+        CloudRegion rows;
+
+        if(!region.isEmpty() && region.endX > width)
+            rows.include(CloudRegion{0, region.startY, 1, region.endY});
+
+        if(!otherRegion.isEmpty() && otherRegion.startX <= 1)
+            rows.include(
+                CloudRegion{0, otherRegion.startY, 1, otherRegion.endY});
+
+        rows = rows.intersected(CloudRegion{0, 1, 1, height + 1});
+
+        if(!rows.isEmpty()) {
+
+            const float rate =
+                edgeDiffusionRate(a, cloud.m_lodFactor, right->m_lodFactor);
+
+            for(size_t y = rows.startY; y < rows.endY; ++y) {
+                const float moved = (density(width, y) - other(1, y)) * rate;
+                density(width, y) -= moved;
+                other(1, y) += moved;
+            }
+
+            region.include(
+                CloudRegion{width, rows.startY, width + 1, rows.endY});
+            otherRegion.include(CloudRegion{1, rows.startY, 2, rows.endY});
+        }
+    }
+
+    if(CompoundCloudComponent* const lower = cloud.m_lowerCloud) {
+
+        const CloudDensityView other =
+            lower->m_densities.getPaddedDensity(channel);
+        CloudRegion& otherRegion = lower->m_densities.getActiveRegion(channel);
+
+        // The columns that have something on either side of the edge
+        CloudRegion columns;
+
+        if(!region.isEmpty() && region.endY > height)
+            columns.include(CloudRegion{region.startX, 0, region.endX, 1});
+
+        if(!otherRegion.isEmpty() && otherRegion.startY <= 1)
+            columns.include(
+                CloudRegion{otherRegion.startX, 0, otherRegion.endX, 1});
+
+        columns = columns.intersected(CloudRegion{1, 0, width + 1, 1});
+
+        if(!columns.isEmpty()) {
+
+            const float rate =
+                edgeDiffusionRate(a, cloud.m_lodFactor, lower->m_lodFactor);
+
+            for(size_t x = columns.startX; x < columns.endX; ++x) {
+                const float moved = (density(x, height) - other(x, 1)) * rate;
+                density(x, height) -= moved;
+                other(x, 1) += moved;
+            }
+
+            region.include(
+                CloudRegion{columns.startX, height, columns.endX, height + 1});
+            otherRegion.include(
+                CloudRegion{columns.startX, 1, columns.endX, 2});
+        }
+    }
+}
+
+void
+    CompoundCloudSystem::prepareCloudHalo(CompoundCloudComponent& cloud,
+        size_t channel) const
+{
+    CloudDensityStorage& storage = cloud.m_densities;
+    const size_t width = storage.getWidth();
+    const size_t height = storage.getHeight();
+
+    const CloudDensityView density = storage.getPaddedDensity(channel);
+    const CloudDensityView oldDens = storage.getPaddedOldDensity(channel);
+
+    // The neighbours have already collected what was moved into the halo
+    if(cloud.m_haloSides[channel] != 0) {
+        density.clear({0, 0, width + 2, 1});
+        density.clear({0, height + 1, width + 2, height + 2});
+        density.clear({0, 1, 1, height + 1});
+        density.clear({width + 1, 1, width + 2, height + 1});
+
+        cloud.m_haloSides[channel] = 0;
     }
-    if(cloud.m_compoundId2 != NULL_COMPOUND) {
-        diffuse(0.007f, cloud.m_oldDens2, cloud.m_density2, elapsed);
-        // Move the compound clouds about the velocity field.
-        advect(cloud.m_oldDens2, cloud.m_density2, elapsed, fluidSystem, pos);
+
+    // The diffusion of the channel only moves things inside the cloud, what
+    // moves across the edges to the neighbours is handled by
+    // diffuseCloudEdges. So the halo mirrors the edges and nothing diffuses
+    // into it
+    copyCloudRow(density, 1, oldDens, 0, width);
+    copyCloudRow(density, height, oldDens, height + 1, width);
+
+    for(size_t y = 1; y <= height; ++y) {
+        oldDens(0, y) = density(1, y);
+        oldDens(width + 1, y) = density(width, y);
     }
-    if(cloud.m_compoundId3 != NULL_COMPOUND) {
-        diffuse(0.007f, cloud.m_oldDens3, cloud.m_density3, elapsed);
-        // Move the compound clouds about the velocity field.
-        advect(cloud.m_oldDens3, cloud.m_density3, elapsed, fluidSystem, pos);
+}
+
+void
+    CompoundCloudSystem::collectCloudHalo(CompoundCloudComponent& cloud,
+        size_t channel) const
+{
+    CloudDensityStorage& storage = cloud.m_densities;
+    const size_t width = storage.getWidth();
+    const size_t height = storage.getHeight();
+
+    const CloudDensityView density = storage.getPaddedDensity(channel);
+    CloudRegion& region = storage.getActiveRegion(channel);
+
+    // Each halo cell of a cloud overlaps one cell of a neighbour. When there
+    // is no neighbour the compounds are put back to the closest cell of the
+    // cloud itself
+    for(int dy = -1; dy <= 1; ++dy) {
+        for(int dx = -1; dx <= 1; ++dx) {
+
+            if(dx == 0 && dy == 0)
+                continue;
+
+            CompoundCloudComponent* const neighbour =
+                cloud.getNeighbour(dx, dy);
+
+            const CompoundCloudComponent& source =
+                neighbour ? *neighbour : cloud;
+
+            const HaloAxis xAxis = haloAxis(dx, neighbour != nullptr, width,
+                CLOUD_HALO_LEFT, CLOUD_HALO_RIGHT);
+            const HaloAxis yAxis = haloAxis(dy, neighbour != nullptr, height,
+                CLOUD_HALO_UP, CLOUD_HALO_DOWN);
+
+            // Corners need both of the sides
+            const uint8_t sides = xAxis.side | yAxis.side;
+
+            if((source.m_haloSides[channel] & sides) != sides)
+                continue;
+
+            const ConstCloudDensityView from =
+                source.m_densities.getPaddedDensity(channel);
+
+            for(size_t y = 0; y < yAxis.count; ++y) {
+                for(size_t x = 0; x < xAxis.count; ++x) {
+                    density(xAxis.target + x, yAxis.target + y) +=
+                        from(xAxis.source + x, yAxis.source + y);
+                }
+            }
+
+            region.include(CloudRegion{xAxis.target, yAxis.target,
+                xAxis.target + xAxis.count, yAxis.target + yAxis.count});
+        }
     }
-    if(cloud.m_compoundId4 != NULL_COMPOUND) {
-        diffuse(0.007f, cloud.m_oldDens4, cloud.m_density4, elapsed);
-        // Move the compound clouds about the velocity field.
-        advect(cloud.m_oldDens4, cloud.m_density4, elapsed, fluidSystem, pos);
+}
+
+void
+    CompoundCloudSystem::uploadGroupTexture(size_t group)
+{
+    CloudGroupGraphics& graphics = m_groupGraphics[group];
+    const size_t groups = m_groupGraphics.size();
+
+    // The older of the two textures gets this step
+    const size_t target = 1 - graphics.currentTexture;
+    auto& uploadedRegions = graphics.uploadedRegions[target];
+
+    // The tiles are in row major order in the atlas
+    std::array<CompoundCloudComponent*, 9> clouds;
+
+    // The active regions are in padded coordinates and the halo isn't part
+    // of the texture
+    std::array<std::array<CloudRegion, CLOUDS_IN_ONE>, 9> active;
+
+    // Whether anything in the target texture needs to change. Everything
+    // outside the uploaded regions is already 0
+    bool changed = false;
+
+    for(size_t tile = 0; tile < 9; ++tile) {
+
+        CompoundCloudComponent* cloud =
+            m_cloudIndex[GRID_ORDER[tile] * groups + group];
+        clouds[tile] = cloud;
+
+        for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
+
+            if(cloud && cloud->getCompoundIdForChannel(i) != NULL_COMPOUND) {
+                active[tile][i] = cloud->m_densities.toInterior(
+                    cloud->m_densities.getActiveRegion(i));
+            }
+
+            if(!active[tile][i].isEmpty() ||
+                !uploadedRegions[tile][i].isEmpty())
+                changed = true;
+        }
     }
 
-    // No graphics check
-    if(!cloud.m_texture)
+    // Fully empty groups don't need to upload anything. The target texture
+    // is already empty
+    if(!changed) {
+        swapGroupTextures(graphics);
         return;
+    }
+
+    // A buffer is locked while the upload from it is still in progress. When
+    // the game lags it is normal for the next buffer to still be in use
+    size_t bufferIndex = graphics.nextTextureData;
+    bool found = false;
+
+    for(size_t i = 0; i < CLOUD_TEXTURE_BUFFERS; ++i) {
+
+        const size_t candidate =
+            (graphics.nextTextureData + i) % CLOUD_TEXTURE_BUFFERS;
+
+        if(!graphics.textureData[candidate]->isLocked()) {
+            bufferIndex = candidate;
+            found = true;
+
+            if(i != 0)
+                ++m_lateTextureUploads;
+            break;
+        }
+    }
 
-    if(cloud.m_textureData1->isLocked()) {
-        // Just skip for now. in the future we'll want two rotating buffers.
-        // When the game lags and updates get queued is when this happens. Which
-        // currently happens a lot so this is commented out
-        // LOG_WARNING("CompoundCloud: texture data buffer is still locked, "
-        //             "skipping writing new data");
+    if(!found) {
+        // The densities are kept so the next upload will catch up
+        ++m_skippedTextureUploads;
         return;
     }
 
-    const size_t rowBytes = cloud.m_textureData1->getRowPitch();
-    uint8_t* const pDest = cloud.m_textureData1->getData();
+    graphics.nextTextureData = (bufferIndex + 1) % CLOUD_TEXTURE_BUFFERS;
 
-    // Copy the density vector into the buffer.
+    const bs::SPtr<bs::PixelData>& data = graphics.textureData[bufferIndex];
+    auto& bufferRegions = graphics.textureDataRegions[bufferIndex];
+
+    const size_t rowBytes = data->getRowPitch();
+    const size_t texelBytes = getTexelBytes(m_textureFormat);
 
-    // This is probably branch predictor friendly to move each bunch of pixels
-    // separately
+    // Copy the density vector into the buffer.
 
     // Old Ogre info:
     // Even with that pixel format the actual channel indexes are:
@@ -968,117 +2037,183 @@ void
     // A - 3
     // Channels should now be RGBA
 
-    if(cloud.m_compoundId1 == NULL_COMPOUND)
-        LEVIATHAN_ASSERT(false, "cloud with not even the first compound");
+    for(size_t tile = 0; tile < 9; ++tile) {
+
+        CompoundCloudComponent* const cloud = clouds[tile];
+
+        // Can only happen if indexing the clouds failed
+        if(!cloud)
+            continue;
+
+        uint8_t* const tileStart =
+            data->getData() + (tile / 3) * CLOUD_SIMULATION_HEIGHT * rowBytes +
+            (tile % 3) * CLOUD_SIMULATION_WIDTH * texelBytes;
 
-    // First density. R goes to channel 0 (see above for the mapping)
-    fillCloudChannel(cloud.m_density1, 0, rowBytes, pDest);
+        // Channel i goes to texture channel i: R - 0, G - 1, B - 2, A - 3
+        for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
 
-    // Second. G - 1
-    if(cloud.m_compoundId2 != NULL_COMPOUND)
-        fillCloudChannel(cloud.m_density2, 1, rowBytes, pDest);
-    // Third. B - 2
-    if(cloud.m_compoundId3 != NULL_COMPOUND)
-        fillCloudChannel(cloud.m_density3, 2, rowBytes, pDest);
+            // The part that had something the last time this buffer was used
+            // needs to be cleared. This works even if the cloud in this tile
+            // has changed because the regions are per tile
+            CloudRegion area = active[tile][i];
+            area.include(bufferRegions[tile][i]);
 
-    // Fourth. A - 3
-    if(cloud.m_compoundId4 != NULL_COMPOUND)
-        fillCloudChannel(cloud.m_density4, 3, rowBytes, pDest);
+            if(!area.isEmpty()) {
+                fillCloudChannel(cloud->m_densities.getDensity(i), area, i,
+                    rowBytes, tileStart);
+            }
+
+            bufferRegions[tile][i] = active[tile][i];
+            uploadedRegions[tile][i] = active[tile][i];
+        }
+    }
 
-    // Submit the updated data
-    cloud.m_texture->writeData(cloud.m_textureData1, 0, 0, true);
+    // Submit the updated data. This is copied to the GPU asynchronously and
+    // the buffer stays locked until that is done. writeData has no
+    // destination region so this is always the whole buffer, even when only
+    // a few rows were filled above
+    graphics.textures[target]->writeData(data, 0, 0, true);
+    swapGroupTextures(graphics);
+}
+
+void
+    CompoundCloudSystem::uploadBothGroupTextures(size_t group)
+{
+    // Each upload replaces the older texture and makes it the current one, so
+    // the second one replaces the other texture
+    uploadGroupTexture(group);
+    uploadGroupTexture(group);
 }
 
 void
-    CompoundCloudSystem::fillCloudChannel(
-        const std::vector<std::vector<float>>& density,
+    CompoundCloudSystem::fillCloudChannel(ConstCloudDensityView density,
+        const CloudRegion& area,
         size_t index,
         size_t rowBytes,
         uint8_t* pDest)
 {
-    const auto height = density[0].size();
-    for(size_t j = 0; j < height; j++) {
-        for(size_t i = 0; i < density.size(); i++) {
+    constexpr auto STRIDE = ConstCloudDensityView::ELEMENT_STRIDE;
+
+    if(m_textureFormat == CLOUD_TEXTURE_FORMAT::HALF_FLOAT) {
+
+        for(size_t j = area.startY; j < area.endY; j++) {
+
+            const CloudDensityValue* const source = density.row(j);
+            uint16_t* const destRow =
+                reinterpret_cast<uint16_t*>(pDest + rowBytes * j) + index;
+
+            for(size_t i = area.startX; i < area.endX; i++)
+                destRow[i * CLOUDS_IN_ONE] = floatToHalf(source[i * STRIDE]);
+        }
+
+        return;
+    }
+
+    for(size_t j = area.startY; j < area.endY; j++) {
+
+        const CloudDensityValue* const source = density.row(j);
+        uint8_t* const destRow = pDest + rowBytes * j + index;
+
+        for(size_t i = area.startX; i < area.endX; i++) {
 
             // This formula smoothens the cloud density so that we get gradients
-            // of transparency.
-            // TODO: move this to the shaders for better performance (we would
-            // need to pass a float instead of a byte).
-            int intensity =
-                static_cast<int>(255 * 2 * std::atan(0.003f * density[i][j]));
+            // of transparency. The shader does this in the half float mode
+            int intensity = static_cast<int>(
+                255 * 2 * std::atan(0.003f * source[i * STRIDE]));
 
             // This is the same clamping code as in the old version
             intensity = std::clamp(intensity, 0, 255);
 
-            pDest[rowBytes * j + (i * CLOUD_TEXTURE_BYTES_PER_ELEMENT) +
-                  index] = static_cast<uint8_t>(intensity);
+            destRow[i * CLOUDS_IN_ONE] = static_cast<uint8_t>(intensity);
         }
     }
 }
 
 void
     CompoundCloudSystem::diffuse(float diffRate,
-        std::vector<std::vector<float>>& oldDens,
-        const std::vector<std::vector<float>>& density,
-        float dt)
-{
-    float a = dt * diffRate;
-    for(int x = 1; x < CLOUD_SIMULATION_WIDTH - 1; x++) {
-        for(int y = 1; y < CLOUD_SIMULATION_HEIGHT - 1; y++) {
-            oldDens[x][y] = density[x][y] * (1 - a) +
-                            (oldDens[x - 1][y] + oldDens[x + 1][y] +
-                                oldDens[x][y - 1] + oldDens[x][y + 1]) *
-                                a / 4;
-        }
+        CloudDensityView oldDens,
+        ConstCloudDensityView density,
+        float dt,
+        const CloudRegion& area,
+        bool implicit) const
+{
+    if(implicit) {
+        m_kernels.diffuseImplicit(diffRate, oldDens, density, dt, area);
+    } else {
+        m_kernels.diffuse(diffRate, oldDens, density, dt, area);
     }
 }
 
-void
-    CompoundCloudSystem::advect(const std::vector<std::vector<float>>& oldDens,
-        std::vector<std::vector<float>>& density,
+CloudRegion
+    CompoundCloudSystem::getDiffusedRegion(const CompoundCloudComponent& cloud,
+        size_t channel) const
+{
+    const CloudDensityStorage& storage = cloud.m_densities;
+
+    // The explicit diffusion spreads everything by one cell and the coarse
+    // clouds by one block. The region may include the halo from last time
+    const size_t reach =
+        (cloud.m_channelParameters[channel].implicitDiffusion ?
+                CloudSimulationKernels::IMPLICIT_DIFFUSION_REACH :
+                1) *
+        cloud.m_lodFactor;
+
+    return storage.getActiveRegion(channel)
+        .expanded(reach, storage.getPaddedWidth(), storage.getPaddedHeight())
+        .intersected(storage.getInterior());
+}
+
+CloudRegion
+    CompoundCloudSystem::advect(ConstCloudDensityView oldDens,
+        CloudDensityView density,
         float dt,
         FluidSystem& fluidSystem,
-        Float2 pos)
+        Float2 topLeft,
+        const CloudRegion& area,
+        float viscosity,
+        float cellSize) const
 {
-    for(int x = 0; x < CLOUD_SIMULATION_WIDTH; x++) {
-        for(int y = 0; y < CLOUD_SIMULATION_HEIGHT; y++) {
-            density[x][y] = 0;
-        }
-    }
-
-    // TODO: this is probably the place to move the compounds on the edges into
-    // the next cloud (instead of not handling them here)
-    for(size_t x = 1; x < CLOUD_SIMULATION_WIDTH - 1; x++) {
-        for(size_t y = 1; y < CLOUD_SIMULATION_HEIGHT - 1; y++) {
-            if(oldDens[x][y] > 1) {
-                constexpr float viscosity =
-                    0.0525f; // TODO: give each cloud a viscosity value in the
-                             // JSON file and use it instead.
-                Float2 velocity = fluidSystem.getVelocityAt(
-                                      pos + Float2(x, y) * CLOUD_RESOLUTION) *
-                                  viscosity;
-
-                float dx = x + dt * velocity.X;
-                float dy = y + dt * velocity.Y;
-
-                dx = std::clamp(dx, 0.5f, CLOUD_SIMULATION_WIDTH - 1.5f);
-                dy = std::clamp(dy, 0.5f, CLOUD_SIMULATION_HEIGHT - 1.5f);
-
-                const int x0 = static_cast<int>(dx);
-                const int x1 = x0 + 1;
-                const int y0 = static_cast<int>(dy);
-                const int y1 = y0 + 1;
-
-                float s1 = dx - x0;
-                float s0 = 1.0f - s1;
-                float t1 = dy - y0;
-                float t0 = 1.0f - t1;
-
-                density[x0][y0] += oldDens[x][y] * s0 * t0;
-                density[x0][y1] += oldDens[x][y] * s0 * t1;
-                density[x1][y0] += oldDens[x][y] * s1 * t0;
-                density[x1][y1] += oldDens[x][y] * s1 * t1;
+    // The border cells are the halo, which isn't moved
+    const size_t startX = std::max<size_t>(area.startX, 1);
+    const size_t endX = std::min(area.endX, oldDens.getWidth() - 1);
+    const size_t startY = std::max<size_t>(area.startY, 1);
+    const size_t endY = std::min(area.endY, oldDens.getHeight() - 1);
+
+    // This runs on multiple threads at once so these are on the stack
+    std::array<float, CLOUD_SIMULATION_WIDTH + 2 * CLOUD_HALO> velocityX;
+    std::array<float, CLOUD_SIMULATION_WIDTH + 2 * CLOUD_HALO> velocityY;
+
+    // For finding how far things can have moved
+    float maxSpeed = 0;
+
+    // Compounds that move past the edges go into the halo
+    for(size_t y = startY; y < endY; y++) {
+
+        // The fluid velocity is only needed where there is something to move
+        for(size_t x = startX; x < endX; x++) {
+            if(oldDens(x, y) > 1) {
+                Float2 velocity =
+                    fluidSystem.sampleVelocityAt(
+                        topLeft + Float2(x, y) * cellSize) *
+                    viscosity;
+
+                velocityX[x] = velocity.X;
+                velocityY[x] = velocity.Y;
+
+                maxSpeed = std::max(maxSpeed,
+                    std::max(std::abs(velocity.X), std::abs(velocity.Y)));
+            } else {
+                velocityX[x] = 0;
+                velocityY[x] = 0;
             }
         }
+
+        m_kernels.advectRow(oldDens, density, y, startX, endX, dt,
+            velocityX.data(), velocityY.data());
     }
+
+    // The bilinear scatter also writes one cell further than the target
+    const auto moved = static_cast<size_t>(std::ceil(maxSpeed * dt)) + 1;
+
+    return area.expanded(moved, density.getWidth(), density.getHeight());
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "general/perlin_noise.h"
+#include "microbe_stage/cloud_density_storage.h"
+#include "microbe_stage/cloud_simulation_kernels.h"
+#include "microbe_stage/cloud_tile_cache.h"
 #include "microbe_stage/compounds.h"
 
 #include "engine/component_types.h"
@@ -13,10 +16,16 @@
 #include <bsfUtility/Math/BsVector2.h>
 #include <bsfUtility/Math/BsVector3.h>
 
+#include <array>
 #include <vector>
 
 
 namespace thrive {
+
+namespace test {
+class TestCompoundCloudSystem;
+}
+
 class FluidSystem;
 
 class CompoundCloudSystem;
@@ -40,6 +49,66 @@ constexpr auto CLOUD_SIMULATION_WIDTH =
 constexpr auto CLOUD_SIMULATION_HEIGHT =
     static_cast<int>(CLOUD_Y_EXTENT / CLOUD_RESOLUTION);
 
+//! Cells with less than this after diffusing are cleared so that the active
+//! regions of the clouds can shrink. Only cells with more than 1 are moved by
+//! advect so this doesn't make a visible difference
+constexpr auto CLOUD_EMPTY_THRESHOLD = 0.01f;
+
+//! How many extra cells each cloud has around it for exchanging compounds
+//! with the neighbouring clouds
+constexpr size_t CLOUD_HALO = 1;
+
+//! How many texture upload buffers each cloud rotates between. A buffer can't
+//! be written to while the previous upload from it is still in progress
+constexpr size_t CLOUD_TEXTURE_BUFFERS = 3;
+
+//! How many cloud cells are simulated as one in the clouds next to the
+//! center cloud (the center is always at full resolution). The corner clouds
+//! use CLOUD_CORNER_LOD_FACTOR. The densities are always stored at full
+//! resolution, only the simulation is coarser
+constexpr size_t CLOUD_EDGE_LOD_FACTOR = 2;
+constexpr size_t CLOUD_CORNER_LOD_FACTOR = 4;
+
+static_assert(CLOUD_SIMULATION_WIDTH % CLOUD_CORNER_LOD_FACTOR == 0 &&
+                  CLOUD_SIMULATION_HEIGHT % CLOUD_CORNER_LOD_FACTOR == 0 &&
+                  CLOUD_SIMULATION_WIDTH % CLOUD_EDGE_LOD_FACTOR == 0 &&
+                  CLOUD_SIMULATION_HEIGHT % CLOUD_EDGE_LOD_FACTOR == 0,
+    "the cloud LOD factors need to divide the cloud size");
+
+//! How many times per second the clouds are simulated by default. The clouds
+//! are simulated with a fixed timestep independent of the world tick rate
+constexpr float DEFAULT_CLOUD_SIMULATION_RATE = 20.f;
+
+//! The limits for CompoundCloudSystem::setSimulationRate
+constexpr float MIN_CLOUD_SIMULATION_RATE = 1.f;
+constexpr float MAX_CLOUD_SIMULATION_RATE = 60.f;
+
+//! How many steps of time a cloud group can fall behind before the extra
+//! time is dropped. This is what makes the clouds slow down instead of
+//! taking more and more time when the game can't keep up
+constexpr float CLOUD_MAX_STEP_BACKLOG = 2.f;
+
+//! \brief What is stored in the cloud textures
+enum class CLOUD_TEXTURE_FORMAT {
+    //! 8 bits per channel with the intensity curve applied on the CPU. This
+    //! is the fallback for when half float textures can't be used
+    UNORM8,
+
+    //! The densities as half floats. The shader applies the intensity curve
+    HALF_FLOAT
+};
+
+//! \brief Sides of the halo of a cloud, used as bit flags
+enum CLOUD_HALO_SIDE : uint8_t {
+    CLOUD_HALO_LEFT = 1 << 0,
+    CLOUD_HALO_RIGHT = 1 << 1,
+    CLOUD_HALO_UP = 1 << 2,
+    CLOUD_HALO_DOWN = 1 << 3
+};
+
+static_assert(CLOUDS_IN_ONE == CLOUD_DENSITY_CHANNELS,
+    "cloud density storage channel count doesn't match clouds in one");
+
 // //! This makes the cloud be behind all the cells
 //! Actually this has to be 0 in order for this to match up with mouse
 //! coordinates / world coordinates properly. Or the clouds need to be drawn in
@@ -153,17 +222,22 @@ cloudLocal.Y = 60 / 2 = 30
 Look at the tests for the clouds for more examples
 
 
-When the cloud is rendered the densities from the simulation vector is
-transferred to the texture and the top left is UV coordinate 0, 0 and
-the bottom right is 1, 1.
+When the clouds are rendered the densities of all the 9 clouds of one
+compound group are transferred to one atlas texture that covers the whole
+grid. The clouds are in the atlas in the same places as in the world so
+the top left corner of the top left cloud is UV coordinate 0, 0 and the
+bottom right corner of the bottom right cloud is 1, 1. Each group is drawn
+with one plane, so the draw calls only depend on the number of groups.
 
 
 The implementation is split into CompoundCloudComponent and CompoundCloudSystem
 
 
-\todo Compounds should be able to travel between existing cloud
-entities because otherwise there will be clumping at the edges of the
-entities
+Compounds travel between the clouds through a halo of one cell around each
+cloud. Before diffusing the halo is filled with the edges of the neighbouring
+clouds and after advecting the compounds that were moved into the halo are
+added to the neighbours. At the edges of the whole grid the compounds stay in
+the cloud they are in so that nothing is lost
 
 
 */
@@ -211,6 +285,10 @@ public:
     void
         addCloud(CompoundId compound, float density, size_t x, size_t y);
 
+    //! \brief Variant of addCloud that skips the compound to channel lookup
+    void
+        addCloudToChannel(size_t channel, float density, size_t x, size_t y);
+
     //! Coordinates are in this cloud's coordinate system
     //! \param rate should be less than one.
     int
@@ -221,12 +299,31 @@ public:
     int
         amountAvailable(CompoundId compound, size_t x, size_t y, float rate);
 
+    //! \brief Variant of takeCompound that skips the compound to channel lookup
+    //!
+    //! Used by the absorber which already loops the channels
+    int
+        takeCompoundFromChannel(size_t channel, size_t x, size_t y, float rate);
+
+    //! \brief Variant of amountAvailable that skips the compound to channel
+    //! lookup
+    int
+        amountAvailableInChannel(size_t channel,
+            size_t x,
+            size_t y,
+            float rate) const;
+
     //! Used by CompoundCloudSystem::getAllAvailableAt
     void
         getCompoundsAt(size_t x,
             size_t y,
             std::vector<std::tuple<CompoundId, float>>& result);
 
+    //! \returns The compound in channel (0 - CLOUDS_IN_ONE - 1) or
+    //! NULL_COMPOUND if the channel is unused
+    CompoundId
+        getCompoundIdForChannel(size_t channel) const;
+
     CompoundId
         getCompoundId1() const
     {
@@ -261,6 +358,10 @@ public:
     void
         clearContents();
 
+    //! \returns The cloud with the same compounds at offset (dx, dy) in the
+    //! grid or null. The offsets need to be in the range [-1, 1]
+    CompoundCloudComponent*
+        getNeighbour(int dx, int dy) const;
 
     REFERENCE_HANDLE_UNCOUNTED_TYPE(CompoundCloudComponent);
 
@@ -268,48 +369,44 @@ public:
         componentTypeConvert(THRIVE_COMPONENT::COMPOUND_CLOUD);
 
 protected:
-    bs::HSceneObject m_sceneNode;
-    bs::HRenderable m_renderable;
-
     // True once initialized by CompoundCloudSystem
     bool m_initialized = false;
 
-    //! This is customized with the parameters of this cloud
-    //! \todo Check if one material could be used by setting custom parameters
-    //! on it
-    bs::HMaterial m_planeMaterial;
-    bs::HTexture m_texture;
-    //! \todo Might have to have two buffers for rotating if it happens often
-    //! that the previous buffer is still locked while processing next frame is
-    //! happening
-    bs::SPtr<bs::PixelData> m_textureData1;
-
     //! The world position this cloud is at. Used to despawn and spawn new ones
     //! Y is ignored and replaced with CLOUD_Y_COORDINATE
     Float3 m_position = Float3(0, 0, 0);
 
-    /// The 2D array that contains the current compound clouds and those from
-    /// last frame.
-    //! \todo switch to a single dimensional vector as this vector of vectors is
-    //! not the most efficient
-    std::vector<std::vector<float>> m_density1;
-    std::vector<std::vector<float>> m_density2;
-    std::vector<std::vector<float>> m_density3;
-    std::vector<std::vector<float>> m_density4;
-
-    std::vector<std::vector<float>> m_oldDens1;
-    std::vector<std::vector<float>> m_oldDens2;
-    std::vector<std::vector<float>> m_oldDens3;
-    std::vector<std::vector<float>> m_oldDens4;
+    //! The densities of all the channels of this cloud and those from the last
+    //! frame. Channel index is the same as the SLOT index
+    CloudDensityStorage m_densities;
 
     //! The 3x3 grid of density tiles around this cloud for moving compounds
-    //! between them
-    //! \todo This isn't implemented
+    //! between them. Set by CompoundCloudSystem::rebuildCloudIndex, null at
+    //! the edges of the grid
     CompoundCloudComponent* m_leftCloud = nullptr;
     CompoundCloudComponent* m_rightCloud = nullptr;
     CompoundCloudComponent* m_lowerCloud = nullptr;
     CompoundCloudComponent* m_upperCloud = nullptr;
 
+    //! Which sides of the halo of each channel may have compounds that need
+    //! to be moved to the neighbours. Combination of the CLOUD_HALO_SIDE
+    //! flags
+    std::array<uint8_t, CLOUDS_IN_ONE> m_haloSides = {};
+
+    //! How many cells in each direction are simulated as one. Set by
+    //! CompoundCloudSystem::rebuildCloudIndex based on the grid position
+    size_t m_lodFactor = 1;
+
+    //! \brief The simulation parameters of the compound in one channel.
+    //! Copied from the Compound so the simulation doesn't need to look it up
+    struct ChannelParameters {
+        float diffusionRate = 0;
+        float viscosity = 0;
+        bool implicitDiffusion = false;
+    };
+
+    std::array<ChannelParameters, CLOUDS_IN_ONE> m_channelParameters;
+
     //! The color of the compound cloud.
     //! Every used channel must have alpha of 1. The others have alpha 0 so that
     //! they don't need to be worried about affecting the resulting colours
@@ -331,12 +428,26 @@ protected:
     CompoundCloudSystem& m_owner;
 };
 
+//! \brief Compound to place with CompoundCloudSystem::addClouds
+struct CloudDeposit {
+    CompoundId compound;
+    float amount;
+    Float3 position;
+};
 
+//! \brief Compound to take with CompoundCloudSystem::takeCompounds
+struct CloudTake {
+    CompoundId compound;
+    //! Same as the rate of CompoundCloudSystem::takeCompound
+    float rate;
+    Float3 position;
+};
 
 //! \brief Moves the compound clouds.
 //! \see \ref how_compound_clouds_work
 class CompoundCloudSystem {
     friend CompoundCloudComponent;
+    friend test::TestCompoundCloudSystem;
 
     struct CloudPlaneVertex {
         bs::Vector3 m_pos;
@@ -362,6 +473,17 @@ public:
     void
         Init(CellStageWorld& world);
 
+    //! \brief Selects what is stored in the cloud textures
+    //! \note This needs to be called before the clouds are spawned
+    void
+        setTextureFormat(CLOUD_TEXTURE_FORMAT format);
+
+    CLOUD_TEXTURE_FORMAT
+        getTextureFormat() const
+    {
+        return m_textureFormat;
+    }
+
     //! \brief Sets the clouds that this system manages
     void
         registerCloudTypes(CellStageWorld& world,
@@ -387,14 +509,70 @@ public:
             const Float3& worldPosition,
             float rate);
 
+    //! \brief Places many compounds at once
+    //!
+    //! The deposits are sorted by the cloud they go to and then applied so
+    //! this is a lot faster than calling addCloud for each of them
+    //! \returns The number of deposits that were placed. The ones outside
+    //! the loaded clouds are skipped
+    size_t
+        addClouds(const std::vector<CloudDeposit>& deposits);
+
+    //! \brief Takes many compounds at once
+    //! \param taken Receives the amount taken for each entry in takes (in the
+    //! same order). 0 for the ones outside the loaded clouds
+    //! \note Takes from the same cell are applied in the order they are in
+    void
+        takeCompounds(const std::vector<CloudTake>& takes,
+            std::vector<float>& taken);
+
     //! \brief Returns the total amount of all compounds at position
     std::vector<std::tuple<CompoundId, float>>
         getAllAvailableAt(const Float3& worldPosition);
 
-    //! \brief Clears the contents of all clouds
+    //! \brief Clears the contents of all clouds and forgets the ones that
+    //! aren't loaded
     void
         emptyAllClouds();
 
+    //! \returns How many cloud texture uploads have been skipped because all
+    //! the upload buffers of the cloud were still in use
+    uint64_t
+        getSkippedTextureUploads() const
+    {
+        return m_skippedTextureUploads;
+    }
+
+    //! \returns How many cloud texture uploads had to use a later buffer
+    //! because the next one was still in use. A lot of these means that
+    //! uploads are about to be skipped
+    uint64_t
+        getLateTextureUploads() const
+    {
+        return m_lateTextureUploads;
+    }
+
+    //! \brief Sets how many times per second each cloud group is simulated
+    //!
+    //! Clamped between MIN_CLOUD_SIMULATION_RATE and
+    //! MAX_CLOUD_SIMULATION_RATE
+    void
+        setSimulationRate(float stepsPerSecond);
+
+    float
+        getSimulationRate() const
+    {
+        return 1 / m_simulationInterval;
+    }
+
+    //! \returns How many cloud group steps have been dropped because the
+    //! game couldn't keep up with the simulation rate
+    uint64_t
+        getDroppedSimulationSteps() const
+    {
+        return m_droppedSimulationSteps;
+    }
+
     /**
      * @brief Shuts the system down releasing all current compound cloud
      * entities
@@ -404,8 +582,13 @@ public:
 
     /**
      * @brief Updates the system
-     * @todo Is it too rough if the compound clouds only update every 50
-     * milliseconds. this needs the support of variable timestep
+     *
+     * Each cloud group is simulated with a fixed timestep once enough time
+     * has accumulated for it. The groups start at different points of the
+     * step so that their steps are spread over different ticks. The cloud
+     * channels are simulated on ThreadPool::getShared() and the textures of
+     * the simulated groups are updated once all of them are done. The
+     * rendering interpolates between the last two steps
      */
     void
         Run(CellStageWorld& world, float elapsed);
@@ -486,6 +669,40 @@ protected:
     void
         cloudReportDestroyed(CompoundCloudComponent* cloud);
 
+    //! \brief Finds the cloud that has compound at worldPosition
+    //! \returns The cloud and the channel of compound in it. The cloud is null
+    //! if there isn't one loaded at the position or compound isn't a cloud
+    //! type
+    std::tuple<CompoundCloudComponent*, size_t>
+        findCloudForCompound(CompoundId compound,
+            const Float3& worldPosition) const;
+
+    //! \returns The index in calculateGridPositions order of the grid cell
+    //! that contains worldPosition or -1 if it is outside the loaded clouds
+    int
+        findGridCell(const Float3& worldPosition) const;
+
+    //! \brief Finds the cloud and the cell in it for compound at
+    //! worldPosition. Used by the batched operations
+    //! \returns False if there is no cloud for that
+    bool
+        findCloudCell(CompoundId compound,
+            const Float3& worldPosition,
+            CompoundCloudComponent*& cloud,
+            size_t& channel,
+            size_t& x,
+            size_t& y) const;
+
+    //! \brief Sorts m_batchOperations so that operations on the same cloud
+    //! and channel are next to each other
+    void
+        sortBatchOperations();
+
+    //! \brief Recalculates m_cloudIndex. Needs to be called whenever clouds
+    //! are moved, created or destroyed
+    void
+        rebuildCloudIndex();
+
 private:
     //! \brief Spawns and despawns the cloud entities around the player
     //! \todo This should check if the player has moved at least 10 units to
@@ -500,37 +717,138 @@ private:
     void
         applyNewCloudPositioning();
 
+    //! \returns The key for the cloud of group (first compound) at
+    //! position in m_tileCache
+    static CloudTileKey
+        getTileKey(const Float3& position, CompoundId group);
+
     void
         _spawnCloud(CellStageWorld& world,
             const Float3& pos,
             size_t startIndex);
 
+    //! \brief Runs diffuse and advect on one channel of a cloud
+    //!
+    //! This is called from multiple threads at once, so this may only touch
+    //! the data of this channel
     void
-        processCloud(CompoundCloudComponent& cloud,
+        simulateCloudChannel(CompoundCloudComponent& cloud,
+            size_t channel,
             float elapsed,
-            FluidSystem& fluidSystem);
+            FluidSystem& fluidSystem) const;
 
+    //! \brief Version of simulateCloudChannel for clouds with m_lodFactor
+    //! above 1
+    //!
+    //! Each block of m_lodFactor * m_lodFactor cells is summed into a coarse
+    //! grid which is simulated and then spread back evenly over the block.
+    //! This keeps the total amount of compounds the same
     void
-        initializeCloud(CompoundCloudComponent& cloud, bs::Scene* scene);
+        simulateCoarseCloudChannel(CompoundCloudComponent& cloud,
+            size_t channel,
+            float elapsed,
+            FluidSystem& fluidSystem) const;
 
+    //! \brief Diffuses a channel across the right and lower edges of cloud to
+    //! the neighbours on those sides
+    //!
+    //! The amount moved is calculated once for each pair of cells on the
+    //! edge and taken from one side and added to the other, so the total
+    //! stays the same even when the clouds have different m_lodFactors. The
+    //! active regions of both clouds are grown to the edge where something
+    //! might have moved. Touches the neighbours so this needs to be called on
+    //! the main thread
     void
-        fillCloudChannel(const std::vector<std::vector<float>>& density,
+        diffuseCloudEdges(
+            CompoundCloudComponent& cloud, size_t channel, float elapsed);
+
+    //! \brief Clears the halo of the densities of a channel and makes the
+    //! halo of the old densities mirror its edges
+    //!
+    //! Called by simulateCloudChannel. The neighbours have collected what was
+    //! moved into the halo on the last step. Only this channel is written to
+    void
+        prepareCloudHalo(CompoundCloudComponent& cloud, size_t channel) const;
+
+    //! \brief Adds the compounds the neighbours moved to their halos to this
+    //! channel
+    //!
+    //! This is ran in parallel for all the channels after all of them have
+    //! been simulated. Only the inside of this channel is written to
+    void
+        collectCloudHalo(CompoundCloudComponent& cloud, size_t channel) const;
+
+    //! \brief Copies the densities of the clouds of group to its atlas
+    //! \note Needs to be called on the main thread
+    void
+        uploadGroupTexture(size_t group);
+
+    //! \brief Uploads the current densities of group to both of its textures
+    //!
+    //! For when the clouds have moved to different tiles of the atlas and the
+    //! older texture would show them in the wrong place
+    //! \note Needs to be called on the main thread
+    void
+        uploadBothGroupTextures(size_t group);
+
+    //! \brief Adds elapsed to the accumulators and fills m_steppedGroups
+    void
+        scheduleGroupSteps(float elapsed);
+
+    //! \brief Creates the atlases and planes for all the cloud groups
+    void
+        createGroupGraphics(bs::Scene* scene);
+
+    void
+        destroyGroupGraphics();
+
+    void
+        initializeCloud(CompoundCloudComponent& cloud);
+
+    //! \brief Writes the cells in area of density to the texture channel index
+    //!
+    //! The values written depend on m_textureFormat
+    void
+        fillCloudChannel(ConstCloudDensityView density,
+            const CloudRegion& area,
             size_t index,
             size_t rowBytes,
             uint8_t* pDest);
 
+    //! \param implicit Selects CloudSimulationKernels::diffuseImplicit
     void
         diffuse(float diffRate,
-            std::vector<std::vector<float>>& oldDens,
-            const std::vector<std::vector<float>>& density,
-            float dt);
+            CloudDensityView oldDens,
+            ConstCloudDensityView density,
+            float dt,
+            const CloudRegion& area,
+            bool implicit = false) const;
 
-    void
-        advect(const std::vector<std::vector<float>>& oldDens,
-            std::vector<std::vector<float>>& density,
+    //! \returns The part of a channel of cloud that the diffusion touches, in
+    //! padded coordinates
+    CloudRegion
+        getDiffusedRegion(const CompoundCloudComponent& cloud,
+            size_t channel) const;
+
+    //! \brief Moves the compounds in area of oldDens into density
+    //!
+    //! density needs to be already cleared
+    //! \param topLeft World position (X, Z) of the first cell of the cloud,
+    //! including the halo.
+    //! The fluid velocity is sampled at the position of each cell
+    //! \param viscosity Multiplier for the fluid velocity
+    //! \param cellSize The size of a cell in world units
+    //! \returns The region of density that the compounds may have been moved
+    //! to
+    CloudRegion
+        advect(ConstCloudDensityView oldDens,
+            CloudDensityView density,
             float dt,
             FluidSystem& fluidSystem,
-            Float2 pos);
+            Float2 topLeft,
+            const CloudRegion& area,
+            float viscosity,
+            float cellSize = CLOUD_RESOLUTION) const;
 
 private:
     //! This system now spawns these entities when it needs them
@@ -549,12 +867,126 @@ private:
     //! one cloud
     std::vector<Compound> m_cloudTypes;
 
+    //! Covers the whole 3x3 grid
     bs::HMesh m_planeMesh;
 
     bs::HTexture m_perlinNoise;
 
+    //! Shared by all the cloud group materials
+    bs::HShader m_cloudShader;
+
+    //! \brief The atlas texture and the plane that draws all the clouds of
+    //! one compound group
+    struct CloudGroupGraphics {
+        bs::HSceneObject sceneNode;
+        bs::HRenderable renderable;
+        bs::HMaterial material;
+
+        //! The two latest simulation steps. The shader interpolates between
+        //! these. Written in turns
+        std::array<bs::HTexture, 2> textures;
+
+        //! The texture in textures that has the latest step
+        size_t currentTexture = 0;
+
+        //! Set when the grid moves. If one of the uploads after that was
+        //! skipped the older texture still has the clouds in the old tiles,
+        //! so only the latest step is shown until the group is simulated
+        //! again
+        bool showLatestOnly = false;
+
+        //! The buffers the texture data is written into before uploading.
+        //! These are used in turns so that a buffer that is still being
+        //! uploaded doesn't stop the next upload
+        std::array<bs::SPtr<bs::PixelData>, CLOUD_TEXTURE_BUFFERS> textureData;
+
+        //! The buffer to try first on the next upload
+        size_t nextTextureData = 0;
+
+        //! The part of each channel of each tile (in row major grid order)
+        //! that has something in each of the buffers
+        std::array<std::array<std::array<CloudRegion, CLOUDS_IN_ONE>, 9>,
+            CLOUD_TEXTURE_BUFFERS>
+            textureDataRegions;
+
+        //! The part of each channel of each tile that was written to each
+        //! texture last time. If this and the active region of the cloud in
+        //! the tile are empty nothing needs to be uploaded
+        std::array<std::array<std::array<CloudRegion, CLOUDS_IN_ONE>, 9>, 2>
+            uploadedRegions;
+    };
+
+    //! Indexed by the cloud group. Empty when there are no graphics
+    std::vector<CloudGroupGraphics> m_groupGraphics;
+
+    //! \brief Makes the texture that was just written the current one
+    void
+        swapGroupTextures(CloudGroupGraphics& graphics);
+
+    //! Which cloud group (index in m_cloudTypes / CLOUDS_IN_ONE) and channel
+    //! each compound is in. Indexed by CompoundId, compounds that aren't
+    //! clouds have NO_CLOUD_SLOT as the group
+    std::vector<std::tuple<size_t, size_t>> m_compoundSlots;
+
+    static constexpr size_t NO_CLOUD_SLOT = static_cast<size_t>(-1);
+
+    //! The clouds at each grid cell around m_cloudGridCenter. Indexed with
+    //! gridCell * group count + group where the grid cell is the index in
+    //! calculateGridPositions order. This is so that finding the cloud for a
+    //! world position doesn't need to look through all the clouds
+    std::vector<CompoundCloudComponent*> m_cloudIndex;
+
     //! This is here to not have to allocate memory every tick
     std::vector<CompoundCloudComponent*> m_tooFarAwayClouds;
+
+    //! The contents of the clouds that have been moved away from the player.
+    //! These are restored when the player comes back
+    CloudTileCache m_tileCache;
+
+    //! \brief An addClouds or takeCompounds entry matched to a cloud cell
+    struct BatchOperation {
+        CompoundCloudComponent* cloud;
+        size_t channel;
+        size_t x;
+        size_t y;
+
+        //! The amount or the rate
+        float value;
+
+        //! Index in the parameters to the batch method
+        size_t index;
+    };
+
+    //! This is here to not have to allocate memory on each batch
+    std::vector<BatchOperation> m_batchOperations;
+
+    CLOUD_TEXTURE_FORMAT m_textureFormat = CLOUD_TEXTURE_FORMAT::HALF_FLOAT;
+
+    uint64_t m_skippedTextureUploads = 0;
+    uint64_t m_lateTextureUploads = 0;
+
+    //! Seconds between the simulation steps of a cloud group
+    float m_simulationInterval = 1 / DEFAULT_CLOUD_SIMULATION_RATE;
+
+    //! The time that hasn't been simulated yet for each cloud group
+    std::vector<float> m_groupTimeAccumulators;
+
+    //! The groups that are simulated this tick. This is here to not have to
+    //! allocate memory every tick
+    std::vector<size_t> m_steppedGroups;
+
+    uint64_t m_droppedSimulationSteps = 0;
+
+    //! The diffuse and advect implementations for this CPU
+    CloudSimulationKernels m_kernels;
+
+    //! The (cloud, channel) pairs to simulate this tick. This is here to not
+    //! have to allocate memory every tick
+    std::vector<std::tuple<CompoundCloudComponent*, size_t>> m_simulationWork;
+
+    //! The (cloud, channel) pairs that may receive compounds from their
+    //! neighbours this tick
+    std::vector<std::tuple<CompoundCloudComponent*, size_t>> m_haloWork;
 };
 
 } // namespace thrive
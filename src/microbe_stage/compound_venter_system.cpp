@@ -56,8 +56,10 @@ void
                 CompoundId compoundId = compound.first;
                 if(venter.ventAmount <= compoundAmount) {
                     Leviathan::Position& position = std::get<2>(*value.second);
-                    venter.ventCompound(
-                        position, compoundId, venter.ventAmount, world);
+                    // Same as ventCompound but batched
+                    m_deposits.push_back(CompoundVenterComponent::ventedDeposit(
+                        compoundId, venter.ventAmount,
+                        position.Members._Position));
                     bag.takeCompound(compoundId, venter.ventAmount);
                     vented = true;
                 }
@@ -70,6 +72,11 @@ void
             }
         }
     }
+
+    if(!m_deposits.empty()) {
+        world.GetCompoundCloudSystem().addClouds(m_deposits);
+        m_deposits.clear();
+    }
 }
 
 void
@@ -78,8 +85,20 @@ void
         double amount,
         CellStageWorld& world)
 {
+    const CloudDeposit deposit =
+        ventedDeposit(compound, amount, pos.Members._Position);
+
     world.GetCompoundCloudSystem().addCloud(
-        compound, amount * 1000.0f, pos.Members._Position);
+        deposit.compound, deposit.amount, deposit.position);
+}
+
+CloudDeposit
+    CompoundVenterComponent::ventedDeposit(CompoundId compound,
+        double amount,
+        const Float3& position)
+{
+    return CloudDeposit{
+        compound, static_cast<float>(amount * 1000.0f), position};
 }
 
 void
@@ -5,6 +5,7 @@
 #include <Entities/Component.h>
 #include <Entities/System.h>
 //#include <Entities/Components.h>
+#include "compound_cloud_system.h"
 #include "process_system.h"
 #include <unordered_map>
 #include <vector>
@@ -35,6 +36,13 @@ public:
             double amount,
             CellStageWorld& world);
 
+    //! \brief Returns what venting amount of compound at position puts in
+    //! the clouds
+    static CloudDeposit
+        ventedDeposit(CompoundId compound,
+            double amount,
+            const Float3& position);
+
     void
         setVentAmount(float amount);
 
@@ -112,5 +120,9 @@ protected:
 private:
     static constexpr float TIME_SCALING_FACTOR = 0.2f;
     float timeSinceLastCycle = 0;
+
+    //! The compounds vented this tick. These are all placed with one call to
+    //! CompoundCloudSystem::addClouds
+    std::vector<CloudDeposit> m_deposits;
 };
 } // namespace thrive
@@ -22,6 +22,17 @@ Compound::Compound(Json::Value value)
     isCloud = value["isCloud"].asBool();
     isUseful = value["isUseful"].asBool();
     isEnvironmental = value["isEnvironmental"].asBool();
+
+    // Optional cloud parameters
+    if(value.isMember("implicitDiffusion"))
+        implicitDiffusion = value["implicitDiffusion"].asBool();
+
+    if(value.isMember("diffusionRate"))
+        diffusionRate = value["diffusionRate"].asFloat();
+
+    if(value.isMember("viscosity"))
+        viscosity = value["viscosity"].asFloat();
+
     // Setting the cloud colour.
     float r = value["colour"]["r"].asFloat();
     float g = value["colour"]["g"].asFloat();
@@ -12,6 +12,17 @@ public:
     bool isCloud = false;
     bool isUseful = false;
     bool isEnvironmental = false;
+
+    //! Clouds of this compound use the implicit diffusion solver which stays
+    //! stable with long timesteps
+    bool implicitDiffusion = false;
+
+    //! How fast clouds of this compound spread out
+    float diffusionRate = 0.007f;
+
+    //! How much clouds of this compound are moved by the fluid currents
+    float viscosity = 0.0525f;
+
     Float4 colour;
 
     Compound();
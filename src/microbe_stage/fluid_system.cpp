@@ -1,5 +1,10 @@
 #include "fluid_system.h"
 
+#include "general/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+
 using namespace thrive;
 
 const Float2 FluidSystem::scale(0.05f, 0.05f);
@@ -16,6 +21,10 @@ void
 {
     millisecondsPassed += elapsed / 1000.f;
 
+    // The time changed so all the velocities changed. The field is only
+    // recalculated when the clouds are simulated, which isn't every tick
+    m_velocityField.current = false;
+
     for(auto& [id, components] : CachedComponents.GetIndex()) {
         Leviathan::PhysicsBody* rigidBody = std::get<1>(*components).GetBody();
 
@@ -29,36 +38,21 @@ void
     }
 }
 
-// TODO: also figure out if there's a way to do this that doesn't generate only
-// horiontal or vertical currents
-Float2
-    FluidSystem::getVelocityAt(Float2 position)
+namespace {
+//! \brief Combines the four noise values (in [0, 1]) into the final velocity
+inline Float2
+    combineNoises(float disturbanceX,
+        float disturbanceY,
+        float currentX,
+        float currentY,
+        float minCurrentIntensity,
+        float disturbanceToCurrentsRatio)
 {
-    const Float2 scaledPosition = position * positionScaling;
+    const float disturbances_x = disturbanceX * 2.0f - 1.0f;
+    const float disturbances_y = disturbanceY * 2.0f - 1.0f;
 
-    const float disturbances_x =
-        noiseDisturbancesX.noise(scaledPosition.X, scaledPosition.Y,
-            millisecondsPassed * disturbanceTimescale) *
-            2.0f -
-        1.0f;
-    ;
-    const float disturbances_y =
-        noiseDisturbancesY.noise(scaledPosition.X, scaledPosition.Y,
-            millisecondsPassed * disturbanceTimescale) *
-            2.0f -
-        1.0f;
-
-    const float currents_x =
-        noiseCurrentsX.noise(scaledPosition.X * currentsStretchingMultiplier,
-            scaledPosition.Y, millisecondsPassed * currentsTimescale) *
-            2.0f -
-        1.0f;
-    const float currents_y =
-        noiseCurrentsY.noise(scaledPosition.X,
-            scaledPosition.Y * currentsStretchingMultiplier,
-            millisecondsPassed * currentsTimescale) *
-            2.0f -
-        1.0f;
+    const float currents_x = currentX * 2.0f - 1.0f;
+    const float currents_y = currentY * 2.0f - 1.0f;
 
     const Float2 disturbancesVelocity(disturbances_x, disturbances_y);
     const Float2 currentsVelocity(
@@ -68,3 +62,141 @@ Float2
     return (disturbancesVelocity * disturbanceToCurrentsRatio +
             currentsVelocity * (1.0f - disturbanceToCurrentsRatio));
 }
+
+//! How many points getVelocitiesAlongRow processes at once
+constexpr size_t VELOCITY_ROW_CHUNK = 64;
+} // namespace
+
+// TODO: also figure out if there's a way to do this that doesn't generate only
+// horiontal or vertical currents
+Float2
+    FluidSystem::getVelocityAt(Float2 position) const
+{
+    const Float2 scaledPosition = position * positionScaling;
+
+    const float disturbanceTime = millisecondsPassed * disturbanceTimescale;
+    const float currentsTime = millisecondsPassed * currentsTimescale;
+
+    return combineNoises(noiseDisturbancesX.noisef(scaledPosition.X,
+                             scaledPosition.Y, disturbanceTime),
+        noiseDisturbancesY.noisef(
+            scaledPosition.X, scaledPosition.Y, disturbanceTime),
+        noiseCurrentsX.noisef(scaledPosition.X * currentsStretchingMultiplier,
+            scaledPosition.Y, currentsTime),
+        noiseCurrentsY.noisef(scaledPosition.X,
+            scaledPosition.Y * currentsStretchingMultiplier, currentsTime),
+        minCurrentIntensity, disturbanceToCurrentsRatio);
+}
+
+void
+    FluidSystem::getVelocitiesAlongRow(Float2 start,
+        float step,
+        Float2* out,
+        size_t count) const
+{
+    const Float2 scaledStart = start * positionScaling;
+    const float scaledStep = step * positionScaling;
+
+    const float disturbanceTime = millisecondsPassed * disturbanceTimescale;
+    const float currentsTime = millisecondsPassed * currentsTimescale;
+
+    // This is called from multiple threads so the temporary values are kept
+    // on the stack
+    std::array<float, VELOCITY_ROW_CHUNK> disturbancesX;
+    std::array<float, VELOCITY_ROW_CHUNK> disturbancesY;
+    std::array<float, VELOCITY_ROW_CHUNK> currentsX;
+    std::array<float, VELOCITY_ROW_CHUNK> currentsY;
+
+    for(size_t done = 0; done < count; done += VELOCITY_ROW_CHUNK) {
+
+        const size_t chunk = std::min(VELOCITY_ROW_CHUNK, count - done);
+        const float x = scaledStart.X + done * scaledStep;
+
+        noiseDisturbancesX.noiseRow(x, scaledStep, scaledStart.Y,
+            disturbanceTime, disturbancesX.data(), chunk);
+        noiseDisturbancesY.noiseRow(x, scaledStep, scaledStart.Y,
+            disturbanceTime, disturbancesY.data(), chunk);
+        noiseCurrentsX.noiseRow(x * currentsStretchingMultiplier,
+            scaledStep * currentsStretchingMultiplier, scaledStart.Y,
+            currentsTime, currentsX.data(), chunk);
+        noiseCurrentsY.noiseRow(x, scaledStep,
+            scaledStart.Y * currentsStretchingMultiplier, currentsTime,
+            currentsY.data(), chunk);
+
+        for(size_t i = 0; i < chunk; ++i) {
+            out[done + i] = combineNoises(disturbancesX[i], disturbancesY[i],
+                currentsX[i], currentsY[i], minCurrentIntensity,
+                disturbanceToCurrentsRatio);
+        }
+    }
+}
+
+Float2
+    FluidSystem::sampleVelocityAt(Float2 position) const
+{
+    const auto& field = m_velocityField;
+
+    if(!field.current)
+        return getVelocityAt(position);
+
+    const float localX = (position.X - field.topLeft.X) / field.spacing;
+    const float localY = (position.Y - field.topLeft.Y) / field.spacing;
+
+    // The last row and column are only used for interpolation so they are
+    // excluded here
+    if(localX < 0 || localY < 0 || localX >= field.width - 1 ||
+        localY >= field.height - 1)
+        return getVelocityAt(position);
+
+    const auto x0 = static_cast<size_t>(localX);
+    const auto y0 = static_cast<size_t>(localY);
+
+    const float s1 = localX - x0;
+    const float s0 = 1.0f - s1;
+    const float t1 = localY - y0;
+    const float t0 = 1.0f - t1;
+
+    const Float2* const row0 = &field.velocities[y0 * field.width];
+    const Float2* const row1 = row0 + field.width;
+
+    return (row0[x0] * s0 + row0[x0 + 1] * s1) * t0 +
+           (row1[x0] * s0 + row1[x0 + 1] * s1) * t1;
+}
+
+void
+    FluidSystem::updateVelocityField(Float2 topLeft,
+        size_t width,
+        size_t height,
+        float spacing)
+{
+    auto& field = m_velocityField;
+
+    if(!(field.topLeft == topLeft && field.width == width &&
+           field.height == height && field.spacing == spacing)) {
+
+        field.topLeft = topLeft;
+        field.width = width;
+        field.height = height;
+        field.spacing = spacing;
+        field.velocities.resize(width * height);
+        field.current = false;
+    }
+
+    if(!field.current)
+        _rebuildVelocityField();
+}
+
+void
+    FluidSystem::_rebuildVelocityField()
+{
+    auto& field = m_velocityField;
+
+    // The rows are independent so they are split between threads
+    ThreadPool::getShared().parallelFor(field.height, [&](size_t y) {
+        getVelocitiesAlongRow(
+            Float2(field.topLeft.X, field.topLeft.Y + y * field.spacing),
+            field.spacing, &field.velocities[y * field.width], field.width);
+    });
+
+    field.current = !field.velocities.empty();
+}
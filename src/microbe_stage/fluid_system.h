@@ -1,11 +1,14 @@
 #pragma once
 
 #include "general/perlin_noise.h"
+
 #include <Entities/Component.h>
 #include <Entities/Components.h>
 #include <Entities/System.h>
 #include <engine/component_types.h>
 
+#include <vector>
+
 namespace thrive {
 
 // TODO: add more variables here for more complex fluid dynamics
@@ -52,14 +55,77 @@ public:
         CachedComponents.RemoveBasedOnKeyTupleList(seconddata);
     }
 
+    //! \brief Calculates the velocity at a point directly from the noise
+    //!
+    //! Prefer sampleVelocityAt for many points in an area that has been
+    //! cached with updateVelocityField
     Float2
-        getVelocityAt(Float2 position);
+        getVelocityAt(Float2 position) const;
+
+    //! \brief Calculates the velocity at count points starting from start and
+    //! going step units in the X direction
+    //!
+    //! This gives the same results as getVelocityAt but is much faster
+    void
+        getVelocitiesAlongRow(Float2 start,
+            float step,
+            Float2* out,
+            size_t count) const;
+
+    //! \brief Returns the velocity at a point bilinearly interpolated from the
+    //! velocity field
+    //!
+    //! Points outside the field, and all points when the field hasn't been
+    //! updated since the last tick, are calculated with getVelocityAt. This
+    //! is safe to call from multiple threads as long as the field isn't being
+    //! updated at the same time
+    Float2
+        sampleVelocityAt(Float2 position) const;
+
+    //! \brief Makes the cached velocity field cover an area and match the
+    //! current time
+    //!
+    //! The field is rebuilt if the area changed or if Run has been called
+    //! since it was last built. Run doesn't rebuild it, so the ticks that
+    //! don't sample the field don't pay for it
+    //! \param topLeft The world position (X, Z) of the first sample
+    //! \param width Number of samples in the X direction
+    //! \param height Number of samples in the Z direction
+    //! \param spacing Distance between samples in world units
+    void
+        updateVelocityField(Float2 topLeft,
+            size_t width,
+            size_t height,
+            float spacing);
 
 private:
+    //! \brief Recalculates all the samples in m_velocityField
+    void
+        _rebuildVelocityField();
+
     Float2
         sampleNoise(Float2 pos, float time);
 
     float millisecondsPassed = 0.0;
+
+    //! \brief The velocity at a grid of points
+    //!
+    //! This is used by the compound clouds, which would otherwise calculate
+    //! the same points multiple times per step. It is only calculated on the
+    //! ticks the clouds are simulated on
+    struct VelocityField {
+        Float2 topLeft = Float2(0, 0);
+        size_t width = 0;
+        size_t height = 0;
+        float spacing = 1.f;
+
+        //! False when the time or the area has changed since the velocities
+        //! were calculated
+        bool current = false;
+
+        //! Row major, X is the faster changing coordinate
+        std::vector<Float2> velocities;
+    } m_velocityField;
     PerlinNoise noiseDisturbancesX;
     PerlinNoise noiseDisturbancesY;
     PerlinNoise noiseCurrentsX;
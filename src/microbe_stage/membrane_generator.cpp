@@ -0,0 +1,458 @@
+// ------------------------------------ //
+#include "microbe_stage/membrane_generator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace thrive;
+
+//! This must be big enough that no organelle can be at this position
+constexpr auto INVALID_FOUND_ORGANELLE = -999999.f;
+
+//! FindClosestOrganelles doesn't find organelles further away than this
+constexpr auto MAX_ORGANELLE_DISTANCE = 2.f;
+
+//! Size of the cells in the organelle lookup grid. A bit larger than the
+//! search distance so that rounding can't put a found organelle more than one
+//! cell away
+constexpr auto ORGANELLE_GRID_CELL_SIZE = MAX_ORGANELLE_DISTANCE * 1.25f;
+
+namespace {
+
+//! \brief The point list of the point insertion and deletion pass
+//!
+//! The pass only inserts and erases right at the index it is at, so the points
+//! before that are final and the points after it are the input in order.
+//! This writes the final points straight to the output instead of moving all
+//! the later points on each insert and erase, and reuses the memory of the
+//! vectors it is given. Indexing works like the vector this replaces
+class MembranePointPass {
+public:
+    MembranePointPass(
+        const std::vector<Float2>& input, std::vector<Float2>& output) :
+        m_input(input),
+        m_output(output)
+    {
+        m_output.clear();
+    }
+
+    size_t
+        size() const
+    {
+        return m_output.size() + m_pendingCount + (m_input.size() - m_next);
+    }
+
+    const Float2& operator[](size_t index) const
+    {
+        if(index < m_output.size())
+            return m_output[index];
+
+        index -= m_output.size();
+
+        if(index < m_pendingCount)
+            return m_pending[index];
+
+        return m_input[m_next + index - m_pendingCount];
+    }
+
+    //! \brief Same as vector.insert(begin() + index, point)
+    //! \note The point before index can't have been passed already
+    void
+        insert(size_t index, const Float2& point)
+    {
+        seek(index - 1);
+
+        // The point before index is kept here as it may still be erased
+        if(m_pendingCount == 0)
+            m_pending[m_pendingCount++] = m_input[m_next++];
+
+        LEVIATHAN_ASSERT(m_pendingCount < m_pending.size(),
+            "too many inserts in a row in membrane generation");
+
+        for(size_t i = m_pendingCount; i > 1; --i)
+            m_pending[i] = m_pending[i - 1];
+
+        m_pending[1] = point;
+        ++m_pendingCount;
+    }
+
+    //! \brief Same as vector.erase(begin() + index)
+    //! \note index can't have been passed already
+    void
+        erase(size_t index)
+    {
+        seek(index);
+        takeNext();
+    }
+
+    //! \brief Moves all the remaining points to the output
+    void
+        finish()
+    {
+        seek(size());
+    }
+
+private:
+    //! \brief Moves the points before index to the output
+    void
+        seek(size_t index)
+    {
+        while(m_output.size() < index)
+            m_output.push_back(takeNext());
+    }
+
+    Float2
+        takeNext()
+    {
+        if(m_pendingCount == 0)
+            return m_input[m_next++];
+
+        const Float2 point = m_pending[0];
+
+        for(size_t i = 1; i < m_pendingCount; ++i)
+            m_pending[i - 1] = m_pending[i];
+
+        --m_pendingCount;
+        return point;
+    }
+
+private:
+    const std::vector<Float2>& m_input;
+    std::vector<Float2>& m_output;
+
+    //! Index of the first input point that hasn't been moved to the output
+    size_t m_next = 0;
+
+    //! Points in front of m_input[m_next]. The inserted ones and the points
+    //! before them
+    std::array<Float2, 3> m_pending;
+    size_t m_pendingCount = 0;
+};
+} // namespace
+
+MembraneGenerator::MembraneGenerator(const MembraneShapeKey& key) :
+    membraneType(key.type), membraneResolution(key.resolution),
+    cellDimensions(key.cellDimensions),
+    organellePositions(key.organellePositions)
+{
+    buildOrganelleGrid();
+}
+
+void
+    MembraneGenerator::buildOrganelleGrid()
+{
+    m_gridCellStart.clear();
+    m_gridOrganelles.clear();
+
+    if(organellePositions.empty()) {
+        m_gridWidth = 0;
+        m_gridHeight = 0;
+        return;
+    }
+
+    Float2 min = organellePositions.front();
+    Float2 max = min;
+
+    for(const auto& pos : organellePositions) {
+        min.X = std::min(min.X, pos.X);
+        min.Y = std::min(min.Y, pos.Y);
+        max.X = std::max(max.X, pos.X);
+        max.Y = std::max(max.Y, pos.Y);
+    }
+
+    m_gridOrigin = min;
+    m_gridWidth =
+        static_cast<int>((max.X - min.X) / ORGANELLE_GRID_CELL_SIZE) + 1;
+    m_gridHeight =
+        static_cast<int>((max.Y - min.Y) / ORGANELLE_GRID_CELL_SIZE) + 1;
+
+    const auto cellOf = [this](const Float2& pos) {
+        const int x = std::min(m_gridWidth - 1,
+            static_cast<int>(
+                (pos.X - m_gridOrigin.X) / ORGANELLE_GRID_CELL_SIZE));
+        const int y = std::min(m_gridHeight - 1,
+            static_cast<int>(
+                (pos.Y - m_gridOrigin.Y) / ORGANELLE_GRID_CELL_SIZE));
+        return y * m_gridWidth + x;
+    };
+
+    // Counting sort keeps the organelles of each cell in index order
+    m_gridCellStart.resize(m_gridWidth * m_gridHeight + 1, 0);
+
+    for(const auto& pos : organellePositions)
+        ++m_gridCellStart[cellOf(pos) + 1];
+
+    for(size_t i = 1; i < m_gridCellStart.size(); ++i)
+        m_gridCellStart[i] += m_gridCellStart[i - 1];
+
+    m_gridOrganelles.resize(organellePositions.size());
+
+    std::vector<uint32_t> written(m_gridCellStart.begin(),
+        m_gridCellStart.end() - 1);
+
+    for(uint32_t i = 0; i < organellePositions.size(); ++i)
+        m_gridOrganelles[written[cellOf(organellePositions[i])]++] = i;
+}
+// ------------------------------------ //
+std::vector<Float2>
+    MembraneGenerator::generate()
+{
+    vertices2D.clear();
+
+    // Room for the amount of points to double. The steps don't allocate once
+    // the buffers are big enough
+    vertices2D.reserve(8 * membraneResolution);
+    relaxedPositions.reserve(8 * membraneResolution);
+
+    for(int i = membraneResolution; i > 0; i--) {
+        vertices2D.emplace_back(-cellDimensions,
+            cellDimensions - 2 * cellDimensions / membraneResolution * i);
+    }
+    for(int i = membraneResolution; i > 0; i--) {
+        vertices2D.emplace_back(
+            cellDimensions - 2 * cellDimensions / membraneResolution * i,
+            cellDimensions);
+    }
+    for(int i = membraneResolution; i > 0; i--) {
+        vertices2D.emplace_back(cellDimensions,
+            -cellDimensions + 2 * cellDimensions / membraneResolution * i);
+    }
+    for(int i = membraneResolution; i > 0; i--) {
+        vertices2D.emplace_back(
+            -cellDimensions + 2 * cellDimensions / membraneResolution * i,
+            -cellDimensions);
+    }
+
+    // Does this need to run 40*cellDimensions times. That seems to be
+    // (reduced from 50 to 40 times, can probabbly be reduced more)
+    for(int i = 0; i < 40 * cellDimensions; i++) {
+        DrawCorrectMembrane();
+    }
+
+    // Subdivide();
+
+    return std::move(vertices2D);
+}
+
+std::vector<Float2>
+    MembraneGenerator::generatePlaceholder(const MembraneShapeKey& key)
+{
+    float radius = 0;
+
+    for(const auto& pos : key.organellePositions)
+        radius = std::max(radius, pos.Length());
+
+    // The generated points settle at the distance FindClosestOrganelles
+    // stops finding organelles at
+    radius += 2;
+
+    // Same amount of points and the same winding as the starting square
+    const int count = 4 * key.resolution;
+
+    std::vector<Float2> points;
+    points.reserve(count);
+
+    for(int i = 0; i < count; ++i) {
+        const float angle = Leviathan::PI - 2 * Leviathan::PI * i / count;
+        points.emplace_back(std::cos(angle) * radius, std::sin(angle) * radius);
+    }
+
+    return points;
+}
+// ------------------------------------ //
+Float2
+    MembraneGenerator::FindClosestOrganelles(const Float2& target) const
+{
+    // The distance we want the membrane to be from the organelles squared.
+    double closestSoFar = MAX_ORGANELLE_DISTANCE * MAX_ORGANELLE_DISTANCE;
+    int closestIndex = -1;
+
+    // Anything close enough is in the cell of target or the ones around it.
+    // Floor is needed as target can be outside the grid on either side
+    const int cellX = static_cast<int>(
+        std::floor((target.X - m_gridOrigin.X) / ORGANELLE_GRID_CELL_SIZE));
+    const int cellY = static_cast<int>(
+        std::floor((target.Y - m_gridOrigin.Y) / ORGANELLE_GRID_CELL_SIZE));
+
+    const int startX = std::max(cellX - 1, 0);
+    const int endX = std::min(cellX + 2, m_gridWidth);
+    const int startY = std::max(cellY - 1, 0);
+    const int endY = std::min(cellY + 2, m_gridHeight);
+
+    for(int y = startY; y < endY; ++y) {
+        for(int x = startX; x < endX; ++x) {
+
+            const int cell = y * m_gridWidth + x;
+
+            for(uint32_t j = m_gridCellStart[cell],
+                         end = m_gridCellStart[cell + 1];
+                j < end; ++j) {
+
+                const int i = m_gridOrganelles[j];
+
+                double lenToObject =
+                    (target - organellePositions[i]).LengthSquared();
+
+                // The cells aren't checked in index order so ties need to go
+                // to the first organelle like they would in a linear scan
+                if(lenToObject < closestSoFar ||
+                    (lenToObject == closestSoFar && i < closestIndex)) {
+                    closestSoFar = lenToObject;
+
+                    closestIndex = i;
+                }
+            }
+        }
+    }
+
+    if(closestIndex != -1)
+        return organellePositions[closestIndex];
+    else
+        return {INVALID_FOUND_ORGANELLE, INVALID_FOUND_ORGANELLE};
+}
+
+Float2
+    MembraneGenerator::GetMovement(const Float2& target,
+        const Float2& closestOrganelle) const
+{
+    double power = pow(2.7, (-(target - closestOrganelle).Length()) / 10) / 50;
+
+    return (closestOrganelle - target) * power;
+}
+
+void
+    MembraneGenerator::DrawCorrectMembrane()
+{
+    switch(membraneType) {
+    case MEMBRANE_TYPE::MEMBRANE: DrawMembrane(); break;
+    case MEMBRANE_TYPE::DOUBLEMEMBRANE: DrawMembrane(); break;
+    case MEMBRANE_TYPE::WALL: DrawCellWall(); break;
+    case MEMBRANE_TYPE::CHITIN: DrawCellWall(); break;
+    }
+}
+// ------------------------------------ //
+void
+    MembraneGenerator::DrawMembrane()
+{
+    // Stores the temporary positions of the membrane.
+    relaxPoints(false);
+
+    // Allows for the addition and deletion of points in the membrane.
+    // This writes the result back to vertices2D
+    MembranePointPass newPositions(relaxedPositions, vertices2D);
+
+    for(size_t i = 0; i < newPositions.size() - 1; i++) {
+        // Check to see if the gap between two points in the membrane is too
+        // big.
+        if((newPositions[i] - newPositions[(i + 1) % newPositions.size()])
+                .Length() > cellDimensions / membraneResolution) {
+            // Add an element after the ith term that is the average of the
+            // i and i+1 term.
+            const auto tempPoint =
+                (newPositions[(i + 1) % newPositions.size()] +
+                    newPositions[i]) /
+                2;
+            newPositions.insert(i + 1, tempPoint);
+
+            i++;
+        }
+
+        // Check to see if the gap between two points in the membrane is too
+        // small.
+        if((newPositions[(i + 1) % newPositions.size()] -
+               newPositions[(i - 1) % newPositions.size()])
+                .Length() < cellDimensions / membraneResolution) {
+            // Delete the ith term.
+            newPositions.erase(i);
+        }
+    }
+
+    newPositions.finish();
+}
+
+void
+    MembraneGenerator::relaxPoints(bool cellWall)
+{
+    relaxedPositions.assign(vertices2D.begin(), vertices2D.end());
+
+    // Loops through all the points in the membrane and relocates them as
+    // necessary.
+    for(size_t i = 0, end = relaxedPositions.size(); i < end; i++) {
+        const auto closestOrganelle = FindClosestOrganelles(vertices2D[i]);
+        if(closestOrganelle ==
+            Float2(INVALID_FOUND_ORGANELLE, INVALID_FOUND_ORGANELLE)) {
+            relaxedPositions[i] =
+                (vertices2D[(end + i - 1) % end] + vertices2D[(i + 1) % end]) /
+                2;
+        } else {
+            const auto movementDirection =
+                cellWall ?
+                    GetMovementForCellWall(vertices2D[i], closestOrganelle) :
+                    GetMovement(vertices2D[i], closestOrganelle);
+            relaxedPositions[i].X -= movementDirection.X;
+            relaxedPositions[i].Y -= movementDirection.Y;
+        }
+    }
+}
+
+/*
+Cell Wall Code Here
+*/
+
+// this is where the magic happens i think
+Float2
+    MembraneGenerator::GetMovementForCellWall(const Float2& target,
+        const Float2& closestOrganelle) const
+{
+    double power = pow(10.0f, (-(target - closestOrganelle).Length())) / 50;
+
+    return (closestOrganelle - target) * power;
+}
+
+void
+    MembraneGenerator::DrawCellWall()
+{
+    // Stores the temporary positions of the membrane.
+    relaxPoints(true);
+
+    // Allows for the addition and deletion of points in the membrane.
+    // This writes the result back to vertices2D
+    MembranePointPass newPositions(relaxedPositions, vertices2D);
+
+    for(size_t i = 0; i < newPositions.size() - 1; i++) {
+        // Check to see if the gap between two points in the membrane is too
+        // big.
+        if((newPositions[i] - newPositions[(i + 1) % newPositions.size()])
+                .Length() > cellDimensions / membraneResolution) {
+            // Add an element after the ith term that is the average of the
+            // i and i+1 term.
+            const auto tempPoint =
+                (newPositions[(i + 1) % newPositions.size()] +
+                    newPositions[i]) /
+                2;
+            newPositions.insert(i + 1, tempPoint);
+
+            // Check to see if the gap between two points in the wall is too
+            // small.
+            if((newPositions[(i + 1) % newPositions.size()] -
+                   newPositions[(i - 1) % newPositions.size()])
+                    .Length() < cellDimensions / membraneResolution) {
+                // Delete the ith term.
+                newPositions.erase(i);
+            }
+            i++;
+        }
+
+        // Check to see if the gap between two points in the membrane is too
+        // small.
+        if((newPositions[(i + 1) % newPositions.size()] -
+               newPositions[(i - 1) % newPositions.size()])
+                .Length() < cellDimensions / membraneResolution) {
+            // Delete the ith term.
+            newPositions.erase(i);
+        }
+    }
+
+    newPositions.finish();
+}
@@ -0,0 +1,99 @@
+#pragma once
+// Thrive Game
+// Copyright (C) 2013-2019  Revolutionary Games
+// ------------------------------------ //
+#include "microbe_stage/membrane_shape_cache.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace thrive {
+
+//! \brief Generates the 2D points of a membrane from the organelle positions
+//!
+//! This only works on its own copy of the inputs so that it can be ran on a
+//! worker thread while the MembraneComponent is in use
+class MembraneGenerator {
+public:
+    explicit MembraneGenerator(const MembraneShapeKey& key);
+
+    //! \brief Runs the whole generation from the starting square
+    //! \returns The generated points
+    std::vector<Float2>
+        generate();
+
+    //! \brief A circle around the organelles to show until the real membrane
+    //! is generated
+    static std::vector<Float2>
+        generatePlaceholder(const MembraneShapeKey& key);
+
+    // Creates the 2D points in the membrane by looking at the positions of the
+    // organelles.
+    void
+        DrawMembrane();
+
+    void
+        DrawCorrectMembrane();
+
+    // Cell Wall COde
+    // Creates the 2D points in the membrane by looking at the positions of the
+    // organelles.
+    void
+        DrawCellWall();
+
+    // Return the position of the closest organelle to the target
+    // point if it is less then a certain threshold away.
+    //! \note Only the organelles in the grid cells around target are checked
+    Float2
+        FindClosestOrganelles(const Float2& target) const;
+
+    // Decides where the point needs to move based on the position of the
+    // closest organelle.
+    Float2
+        GetMovement(const Float2& target, const Float2& closestOrganelle) const;
+
+    Float2
+        GetMovementForCellWall(const Float2& target,
+            const Float2& closestOrganelle) const;
+
+private:
+    //! \brief Sorts organellePositions into the lookup grid
+    void
+        buildOrganelleGrid();
+
+    //! \brief Moves the points of vertices2D towards or away from the
+    //! organelles into relaxedPositions
+    void
+        relaxPoints(bool cellWall);
+
+private:
+    const MEMBRANE_TYPE membraneType;
+
+    //! Amount of segments on one side of the starting square
+    const int membraneResolution;
+
+    //! Half the side length of the starting square
+    const int cellDimensions;
+
+    // Stores the positions of the organelles.
+    const std::vector<Float2> organellePositions;
+
+    //! The points being generated
+    std::vector<Float2> vertices2D;
+
+    //! The moved points of each step before the points are added and removed.
+    //! Kept to reuse the memory
+    std::vector<Float2> relaxedPositions;
+
+    //! Position of the top left corner of the organelle lookup grid
+    Float2 m_gridOrigin;
+    int m_gridWidth = 0;
+    int m_gridHeight = 0;
+
+    //! The organelles in grid cell i are m_gridOrganelles[m_gridCellStart[i]]
+    //! up to m_gridOrganelles[m_gridCellStart[i + 1]], in index order
+    std::vector<uint32_t> m_gridCellStart;
+    std::vector<uint32_t> m_gridOrganelles;
+};
+
+} // namespace thrive
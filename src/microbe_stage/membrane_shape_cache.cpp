@@ -0,0 +1,102 @@
+// ------------------------------------ //
+#include "microbe_stage/membrane_shape_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace thrive;
+// ------------------------------------ //
+bool
+    MembraneShapeKey::operator==(const MembraneShapeKey& other) const
+{
+    return type == other.type && resolution == other.resolution &&
+           cellDimensions == other.cellDimensions &&
+           organellePositions == other.organellePositions;
+}
+
+size_t
+    MembraneShapeKeyHash::operator()(const MembraneShapeKey& key) const
+{
+    size_t hash = std::hash<int>()(static_cast<int>(key.type));
+
+    const auto combine = [&hash](size_t value) {
+        hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    };
+
+    combine(std::hash<int>()(key.resolution));
+    combine(std::hash<int>()(key.cellDimensions));
+
+    for(const auto& position : key.organellePositions) {
+        combine(std::hash<float>()(position.X));
+        combine(std::hash<float>()(position.Y));
+    }
+
+    return hash;
+}
+// ------------------------------------ //
+std::shared_ptr<MembraneShape>
+    MembraneShapeCache::find(const MembraneShapeKey& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto found = m_shapes.find(key);
+
+    if(found == m_shapes.end())
+        return nullptr;
+
+    // Null if the last user was just released
+    return found->second.lock();
+}
+
+std::shared_ptr<MembraneShape>
+    MembraneShapeCache::insert(
+        MembraneShapeKey key, std::vector<Float2> vertices2D)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& entry = m_shapes[std::move(key)];
+
+    if(auto existing = entry.lock())
+        return existing;
+
+    auto shape = std::make_shared<MembraneShape>();
+    shape->vertices2D = std::move(vertices2D);
+
+    entry = shape;
+
+    if(m_shapes.size() >= m_nextCleanup) {
+        removeExpired();
+        m_nextCleanup = std::max<size_t>(64, m_shapes.size() * 2);
+    }
+
+    return shape;
+}
+
+size_t
+    MembraneShapeCache::size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    removeExpired();
+    return m_shapes.size();
+}
+// ------------------------------------ //
+void
+    MembraneShapeCache::removeExpired()
+{
+    for(auto iter = m_shapes.begin(); iter != m_shapes.end();) {
+
+        if(iter->second.expired()) {
+            iter = m_shapes.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+// ------------------------------------ //
+MembraneShapeCache&
+    MembraneShapeCache::getShared()
+{
+    static MembraneShapeCache cache;
+    return cache;
+}
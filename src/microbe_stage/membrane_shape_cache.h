@@ -0,0 +1,86 @@
+#pragma once
+// Thrive Game
+// Copyright (C) 2013-2019  Revolutionary Games
+// ------------------------------------ //
+#include "microbe_stage/membrane_system.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace thrive {
+
+//! \brief Everything the generated membrane vertices depend on
+struct MembraneShapeKey {
+    MEMBRANE_TYPE type;
+    int resolution;
+
+    //! After it has been grown to fit the organelles
+    int cellDimensions;
+
+    std::vector<Float2> organellePositions;
+
+    bool
+        operator==(const MembraneShapeKey& other) const;
+};
+
+struct MembraneShapeKeyHash {
+    size_t
+        operator()(const MembraneShapeKey& key) const;
+};
+
+//! \brief A generated membrane shared by all the membranes with the same
+//! MembraneShapeKey
+struct MembraneShape {
+    std::vector<Float2> vertices2D;
+
+    //! Created by the first membrane that is shown with this shape. Only
+    //! touched from the main thread
+    bs::HMesh mesh;
+};
+
+//! \brief Process wide cache of the generated membrane shapes
+//!
+//! All the members of a species have the same organelle layout so only the
+//! first one needs to run the membrane generation. The membranes keep
+//! references to the shapes they use and the cache only has weak ones, so a
+//! shape is dropped when the last membrane using it is released
+class MembraneShapeCache {
+public:
+    //! \returns The shape for key or null if there isn't one
+    std::shared_ptr<MembraneShape>
+        find(const MembraneShapeKey& key);
+
+    //! \brief Stores a newly generated shape
+    //! \returns The stored shape. If another one was stored for key while
+    //! this one was being generated that is returned instead
+    std::shared_ptr<MembraneShape>
+        insert(MembraneShapeKey key, std::vector<Float2> vertices2D);
+
+    //! \returns How many shapes are in use
+    size_t
+        size();
+
+    //! \brief The cache used by all the MembraneComponents
+    static MembraneShapeCache&
+        getShared();
+
+private:
+    //! \brief Removes the entries of the shapes that are no longer in use
+    //! \note m_mutex needs to be locked
+    void
+        removeExpired();
+
+private:
+    std::mutex m_mutex;
+
+    std::unordered_map<MembraneShapeKey, std::weak_ptr<MembraneShape>,
+        MembraneShapeKeyHash>
+        m_shapes;
+
+    //! The expired entries are removed when there are this many entries
+    size_t m_nextCleanup = 64;
+};
+
+} // namespace thrive
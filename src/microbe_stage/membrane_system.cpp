@@ -1,5 +1,8 @@
 #include "membrane_system.h"
 
+#include "general/thread_pool.h"
+#include "microbe_stage/membrane_generator.h"
+
 #include <Engine.h>
 #include <Rendering/Graphics.h>
 #include <bsfCore/Components/BsCRenderable.h>
@@ -10,16 +13,55 @@
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 using namespace thrive;
 
+namespace {
+//! \brief Counts the membrane generations on the thread pool that haven't
+//! finished yet
+//!
+//! They use MembraneShapeCache::getShared, which is destroyed when the game
+//! exits. MembraneSystem waits for them when it is destroyed so that none of
+//! them are still running at that point
+class PendingMembraneGenerations {
+public:
+    //! \returns A token that keeps one generation counted until it and its
+    //! copies are destroyed
+    std::shared_ptr<void>
+        add()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_count;
+
+        return std::shared_ptr<void>(nullptr, [this](void*) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_count;
+            m_allDone.notify_all();
+        });
+    }
+
+    void
+        waitForAll()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_allDone.wait(lock, [this]() { return m_count == 0; });
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_allDone;
+    size_t m_count = 0;
+};
+
+PendingMembraneGenerations pendingGenerations;
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 // Membrane Component
 ////////////////////////////////////////////////////////////////////////////////
 
-//! This must be big enough that no organelle can be at this position
-constexpr auto INVALID_FOUND_ORGANELLE = -999999.f;
-
 MembraneComponent::MembraneComponent(MEMBRANE_TYPE type) :
     Leviathan::Component(TYPE)
 {
@@ -58,65 +100,14 @@ void
     }
 }
 // ------------------------------------ //
-Float2
-    MembraneComponent::FindClosestOrganelles(const Float2& target)
-{
-    // The distance we want the membrane to be from the organelles squared.
-    double closestSoFar = 4;
-    int closestIndex = -1;
-
-    for(size_t i = 0, end = organellePositions.size(); i < end; i++) {
-        double lenToObject = (target - organellePositions[i]).LengthSquared();
-
-        if(lenToObject < 4 && lenToObject < closestSoFar) {
-            closestSoFar = lenToObject;
-
-            closestIndex = i;
-        }
-    }
-
-    if(closestIndex != -1)
-        return organellePositions[closestIndex];
-    else
-        return {INVALID_FOUND_ORGANELLE, INVALID_FOUND_ORGANELLE};
-}
-
-Float2
-    MembraneComponent::GetMovement(const Float2& target,
-        const Float2& closestOrganelle)
-{
-    double power = pow(2.7, (-(target - closestOrganelle).Length()) / 10) / 50;
-
-    return (closestOrganelle - target) * power;
-}
-
 Float3
     MembraneComponent::GetExternalOrganelle(double x, double y)
 {
     // This gets called by the flagella every frame as on the first call this
     // object is not initialized yet. TODO: do something about that
-
-    // This was causing little regular-interval lag bursts
-    /*if(vertices2D.empty())
-        LOG_WARNING("MembraneComponent: GetExternalOrganelle: called before "
-                    "membrane is initialized. Returning 0, 0");
-    */
-
-
-
-    float organelleAngle = std::atan2(y, x);
-
-    Float3 closestSoFar(0, 0, 0);
-    float angleToClosest = Leviathan::PI * 2;
-
-    for(const auto& vertex : vertices2D) {
-        if(std::abs(std::atan2(vertex.Y, vertex.X) - organelleAngle) <
-            angleToClosest) {
-            closestSoFar = Float3(vertex.X, vertex.Y, 0);
-            angleToClosest =
-                std::abs(std::atan2(vertex.Y, vertex.X) - organelleAngle);
-        }
-    }
+    // Until then this returns 0, 0. The vertices are sorted by angle
+    // beforehand so this doesn't need an atan2 for each of them
+    const auto closestSoFar = m_vertexAngles.findClosest(std::atan2(y, x));
 
     // Swap to world coordinates from internal membrane coordinates
     return Float3(closestSoFar.X, 0, closestSoFar.Y);
@@ -222,13 +213,80 @@ void
     if(isInitialized)
         return;
 
-    if(!isInitialized)
-        Initialize();
+    if(!m_shape) {
+
+        if(!m_pendingShape.valid())
+            Initialize();
+
+        if(m_pendingShape.valid()) {
+
+            if(m_pendingShape.wait_for(std::chrono::seconds(0)) !=
+                std::future_status::ready) {
+
+                // The placeholder is shown until the generation is done
+                if(!m_mesh && Engine::Get()->IsInGraphicalMode()) {
+                    attachMesh(
+                        scene, parentComponentPos, createMesh(vertexDesc));
+                }
+
+                return;
+            }
+
+            m_shape = m_pendingShape.get();
+            vertices2D = m_shape->vertices2D;
+            m_vertexAngles.build(vertices2D);
+            m_isEncompassingCircleCalculated = false;
+        }
+    }
+
+    isInitialized = true;
 
     // Skip if no graphics
     if(!Engine::Get()->IsInGraphicalMode())
         return;
 
+    // The mesh only depends on the shape so it is shared as well
+    if(!m_shape->mesh)
+        m_shape->mesh = createMesh(vertexDesc);
+
+    attachMesh(scene, parentComponentPos, m_shape->mesh);
+}
+
+void
+    MembraneComponent::attachMesh(bs::Scene* scene,
+        const bs::HSceneObject& parentComponentPos,
+        const bs::HMesh& mesh)
+{
+    m_mesh = mesh;
+
+    // The material is kept when the placeholder is replaced
+    if(!coloredMaterial) {
+        // TODO: the material needs to be only recreated when the species
+        // properties change, not every time an organelle is added or removed
+        // Set the membrane material //
+        auto baseMaterial = chooseMaterialByType();
+
+        LEVIATHAN_ASSERT(baseMaterial, "no material for membrane");
+
+        // The baseMaterial fetch makes a new instance so this is fine
+        coloredMaterial = baseMaterial;
+
+        coloredMaterial->setVec4("gTint", colour);
+        coloredMaterial->setFloat("gHealthFraction", healthFraction);
+    }
+
+    if(!m_item)
+        m_item = parentComponentPos->addComponent<bs::CRenderable>();
+
+    m_item->setMaterial(coloredMaterial);
+    m_item->setMesh(m_mesh);
+    m_item->setLayer(1 << *scene);
+}
+
+bs::HMesh
+    MembraneComponent::createMesh(
+        const bs::SPtr<bs::VertexDataDesc>& vertexDesc)
+{
     // This is a triangle fan so we only need 2 + n vertices
     // This is actually a triangle list, but the index buffer is used to build
     // the indices (to emulate a triangle fan)
@@ -279,43 +337,12 @@ void
                                                "fill vertex buffer");
 
 
-    m_mesh = bs::Mesh::create(meshData, meshDesc);
     // // Set the bounds to get frustum culling and LOD to work correctly.
     // // TODO: make this more accurate by calculating the actual extents
     // m_mesh->_setBounds(Ogre::Aabb(Float3::ZERO, Float3::UNIT_SCALE * 50)
     //     /*, false*/);
     // m_mesh->_setBoundingSphereRadius(50);
-
-    // TODO: the material needs to be only recreated when the species properties
-    // change, not every time an organelle is added or removed
-    // Set the membrane material //
-    auto baseMaterial = chooseMaterialByType();
-
-    LEVIATHAN_ASSERT(baseMaterial, "no material for membrane");
-
-    // The baseMaterial fetch makes a new instance so this is fine
-    coloredMaterial = baseMaterial;
-
-    coloredMaterial->setVec4("gTint", colour);
-    coloredMaterial->setFloat("gHealthFraction", healthFraction);
-
-    if(!m_item)
-        m_item = parentComponentPos->addComponent<bs::CRenderable>();
-
-    m_item->setMaterial(coloredMaterial);
-    m_item->setMesh(m_mesh);
-    m_item->setLayer(1 << *scene);
-}
-
-void
-    MembraneComponent::DrawCorrectMembrane()
-{
-    switch(membraneType) {
-    case MEMBRANE_TYPE::MEMBRANE: DrawMembrane(); break;
-    case MEMBRANE_TYPE::DOUBLEMEMBRANE: DrawMembrane(); break;
-    case MEMBRANE_TYPE::WALL: DrawCellWall(); break;
-    case MEMBRANE_TYPE::CHITIN: DrawCellWall(); break;
-    }
+    return bs::Mesh::create(meshData, meshDesc);
 }
 
 size_t
@@ -438,96 +465,40 @@ void
         }
     }
 
-    for(int i = membraneResolution; i > 0; i--) {
-        vertices2D.emplace_back(-cellDimensions,
-            cellDimensions - 2 * cellDimensions / membraneResolution * i);
-    }
-    for(int i = membraneResolution; i > 0; i--) {
-        vertices2D.emplace_back(
-            cellDimensions - 2 * cellDimensions / membraneResolution * i,
-            cellDimensions);
-    }
-    for(int i = membraneResolution; i > 0; i--) {
-        vertices2D.emplace_back(cellDimensions,
-            -cellDimensions + 2 * cellDimensions / membraneResolution * i);
-    }
-    for(int i = membraneResolution; i > 0; i--) {
-        vertices2D.emplace_back(
-            -cellDimensions + 2 * cellDimensions / membraneResolution * i,
-            -cellDimensions);
-    }
+    MembraneShapeKey key{
+        membraneType, membraneResolution, cellDimensions, organellePositions};
 
-    // Does this need to run 40*cellDimensions times. That seems to be
-    // (reduced from 50 to 40 times, can probabbly be reduced more)
-    for(int i = 0; i < 40 * cellDimensions; i++) {
-        DrawCorrectMembrane();
-    }
+    m_shape = MembraneShapeCache::getShared().find(key);
 
-    // Subdivide();
+    if(m_shape) {
+        vertices2D = m_shape->vertices2D;
+    } else {
+        // The radius queries use the placeholder until the real one is done
+        vertices2D = MembraneGenerator::generatePlaceholder(key);
 
-    // Reset this cached status as new points have just been generated
-    m_isEncompassingCircleCalculated = false;
-
-    isInitialized = true;
-}
+        // The token is released when the task is done or discarded
+        m_pendingShape = ThreadPool::getShared().submit(
+            [key = std::move(key),
+                pending = pendingGenerations.add()]() mutable {
+                auto& cache = MembraneShapeCache::getShared();
 
+                // Another membrane may have generated this while this was
+                // waiting in the queue
+                if(auto existing = cache.find(key))
+                    return existing;
 
-// ------------------------------------ //
-void
-    MembraneComponent::DrawMembrane()
-{
-    // Stores the temporary positions of the membrane.
-    auto newPositions = vertices2D;
-
-    // Loops through all the points in the membrane and relocates them as
-    // necessary.
-    for(size_t i = 0, end = newPositions.size(); i < end; i++) {
-        const auto closestOrganelle = FindClosestOrganelles(vertices2D[i]);
-        if(closestOrganelle ==
-            Float2(INVALID_FOUND_ORGANELLE, INVALID_FOUND_ORGANELLE)) {
-            newPositions[i] =
-                (vertices2D[(end + i - 1) % end] + vertices2D[(i + 1) % end]) /
-                2;
-        } else {
-            const auto movementDirection =
-                GetMovement(vertices2D[i], closestOrganelle);
-            newPositions[i].X -= movementDirection.X;
-            newPositions[i].Y -= movementDirection.Y;
-        }
+                auto generated = MembraneGenerator(key).generate();
+                return cache.insert(std::move(key), std::move(generated));
+            });
     }
 
-    // Allows for the addition and deletion of points in the membrane.
-    for(size_t i = 0; i < newPositions.size() - 1; i++) {
-        // Check to see if the gap between two points in the membrane is too
-        // big.
-        if((newPositions[i] - newPositions[(i + 1) % newPositions.size()])
-                .Length() > cellDimensions / membraneResolution) {
-            // Add an element after the ith term that is the average of the
-            // i and i+1 term.
-            auto it = newPositions.begin();
-            const auto tempPoint =
-                (newPositions[(i + 1) % newPositions.size()] +
-                    newPositions[i]) /
-                2;
-            newPositions.insert(it + i + 1, tempPoint);
-
-            i++;
-        }
-
-        // Check to see if the gap between two points in the membrane is too
-        // small.
-        if((newPositions[(i + 1) % newPositions.size()] -
-               newPositions[(i - 1) % newPositions.size()])
-                .Length() < cellDimensions / membraneResolution) {
-            // Delete the ith term.
-            auto it = newPositions.begin();
-            newPositions.erase(it + i);
-        }
-    }
+    m_vertexAngles.build(vertices2D);
 
-    vertices2D = newPositions;
+    // Reset this cached status as new points have just been generated
+    m_isEncompassingCircleCalculated = false;
 }
 
+// ------------------------------------ //
 void
     MembraneComponent::sendOrganelles(double x, double y)
 {
@@ -560,85 +531,14 @@ void
 {
     isInitialized = false;
     vertices2D.clear();
+    m_vertexAngles.clear();
     m_mesh = nullptr;
-}
-
-/*
-Cell Wall Code Here
-*/
-
-// this is where the magic happens i think
-Float2
-    MembraneComponent::GetMovementForCellWall(const Float2& target,
-        const Float2& closestOrganelle)
-{
-    double power = pow(10.0f, (-(target - closestOrganelle).Length())) / 50;
+    m_shape.reset();
 
-    return (closestOrganelle - target) * power;
-}
-
-void
-    MembraneComponent::DrawCellWall()
-{
-    // Stores the temporary positions of the membrane.
-    auto newPositions = vertices2D;
-
-    // Loops through all the points in the membrane and relocates them as
-    // necessary.
-    for(size_t i = 0, end = newPositions.size(); i < end; i++) {
-        const auto closestOrganelle = FindClosestOrganelles(vertices2D[i]);
-        if(closestOrganelle ==
-            Float2(INVALID_FOUND_ORGANELLE, INVALID_FOUND_ORGANELLE)) {
-            newPositions[i] =
-                (vertices2D[(end + i - 1) % end] + vertices2D[(i + 1) % end]) /
-                2;
-        } else {
-            const auto movementDirection =
-                GetMovementForCellWall(vertices2D[i], closestOrganelle);
-            newPositions[i].X -= movementDirection.X;
-            newPositions[i].Y -= movementDirection.Y;
-        }
-    }
-
-    // Allows for the addition and deletion of points in the membrane.
-    for(size_t i = 0; i < newPositions.size() - 1; i++) {
-        // Check to see if the gap between two points in the membrane is too
-        // big.
-        if((newPositions[i] - newPositions[(i + 1) % newPositions.size()])
-                .Length() > cellDimensions / membraneResolution) {
-            // Add an element after the ith term that is the average of the
-            // i and i+1 term.
-            auto it = newPositions.begin();
-            const auto tempPoint =
-                (newPositions[(i + 1) % newPositions.size()] +
-                    newPositions[i]) /
-                2;
-            newPositions.insert(it + i + 1, tempPoint);
-
-            // Check to see if the gap between two points in the wall is too
-            // small.
-            if((newPositions[(i + 1) % newPositions.size()] -
-                   newPositions[(i - 1) % newPositions.size()])
-                    .Length() < cellDimensions / membraneResolution) {
-                // Delete the ith term.
-                auto it = newPositions.begin();
-                newPositions.erase(it + i);
-            }
-            i++;
-        }
-
-        // Check to see if the gap between two points in the membrane is too
-        // small.
-        if((newPositions[(i + 1) % newPositions.size()] -
-               newPositions[(i - 1) % newPositions.size()])
-                .Length() < cellDimensions / membraneResolution) {
-            // Delete the ith term.
-            auto it = newPositions.begin();
-            newPositions.erase(it + i);
-        }
-    }
-
-    vertices2D = newPositions;
+    // A new material is made in case the type was changed. A pending
+    // generation is left to finish in the background and ends up in the cache
+    coloredMaterial = nullptr;
+    m_pendingShape = {};
 }
 // ------------------------------------ //
 // MembraneSystem
@@ -655,7 +555,12 @@ struct MembraneSystem::Implementation {
 };
 
 MembraneSystem::MembraneSystem() : m_impl(std::make_unique<Implementation>()) {}
-MembraneSystem::~MembraneSystem() {}
+MembraneSystem::~MembraneSystem()
+{
+    // The components may have dropped their pending generations so all of
+    // them are waited for here
+    pendingGenerations.waitForAll();
+}
 
 void
     MembraneSystem::UpdateComponent(MembraneComponent& component,
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "engine/component_types.h"
+#include "microbe_stage/membrane_vertex_angles.h"
 
 #include <Entities/Component.h>
 #include <Entities/Components.h>
@@ -10,9 +11,13 @@
 #include <bsfUtility/Math/BsVector3.h>
 
 #include <atomic>
+#include <future>
+#include <memory>
 
 namespace thrive {
 
+struct MembraneShape;
+
 // enumerable for membrane type
 enum class MEMBRANE_TYPE { MEMBRANE, WALL, CHITIN, DOUBLEMEMBRANE };
 
@@ -84,11 +89,6 @@ public:
     int
         getAbsorbedCompounds();
 
-    // Creates the 2D points in the membrane by looking at the positions of the
-    // organelles.
-    virtual void
-        DrawMembrane();
-
     size_t
         InitializeCorrectMembrane(size_t writeIndex,
             MembraneVertex* meshVertices);
@@ -105,6 +105,8 @@ public:
     float
         calculateEncompassingCircleRadius() const;
 
+    //! \brief Shows the membrane, or a placeholder circle while the real one
+    //! is being generated in the background
     //! \param parentcomponentpos The mesh is attached to this node when the
     //! mesh is created \todo As this is currently only executed once (when
     //! isInitialized is false) this should be changed to directly upload the
@@ -128,16 +130,6 @@ public:
     Float3
         GetExternalOrganelle(double x, double y);
 
-    // Return the position of the closest organelle to the target
-    // point if it is less then a certain threshold away.
-    Float2
-        FindClosestOrganelles(const Float2& target);
-
-    // Decides where the point needs to move based on the position of the
-    // closest organelle.
-    Float2
-        GetMovement(const Float2& target, const Float2& closestOrganelle);
-
     REFERENCE_HANDLE_UNCOUNTED_TYPE(MembraneComponent);
 
     static constexpr auto TYPE =
@@ -150,23 +142,22 @@ public:
     bs::HMaterial
         chooseMaterialByType();
 
+protected:
+    //! Called on first Update. Takes the shape from MembraneShapeCache or
+    //! starts generating it on ThreadPool::getShared() if there isn't one
+    //! with the same organelles. A circle is used in the meantime
     void
-        DrawCorrectMembrane();
-
-    // Cell Wall COde
-    // Creates the 2D points in the membrane by looking at the positions of the
-    // organelles.
-    void
-        DrawCellWall();
+        Initialize();
 
-    Float2
-        GetMovementForCellWall(const Float2& target,
-            const Float2& closestOrganelle);
+    //! \brief Creates the mesh for vertices2D
+    bs::HMesh
+        createMesh(const bs::SPtr<bs::VertexDataDesc>& vertexDesc);
 
-protected:
-    //! Called on first Update
+    //! \brief Shows mesh with the material of this membrane
     void
-        Initialize();
+        attachMesh(bs::Scene* scene,
+            const bs::HSceneObject& parentComponentPos,
+            const bs::HMesh& mesh);
 
     void
         releaseCurrentMesh();
@@ -196,6 +187,17 @@ protected:
     //! Stores the generated 2-Dimensional membrane.
     std::vector<Float2> vertices2D;
 
+    //! vertices2D sorted by angle for GetExternalOrganelle
+    MembraneVertexAngles m_vertexAngles;
+
+    //! The shared shape vertices2D was copied from. Keeps it (and its mesh)
+    //! in MembraneShapeCache while this is using it
+    std::shared_ptr<MembraneShape> m_shape;
+
+    //! The shape being generated in the background. vertices2D is a
+    //! placeholder while this is valid
+    std::future<std::shared_ptr<MembraneShape>> m_pendingShape;
+
     //! Marks if cached encompassing circleradius is calculated
     mutable bool m_isEncompassingCircleCalculated = false;
     //! Cached circle radius
@@ -0,0 +1,90 @@
+// ------------------------------------ //
+#include "microbe_stage/membrane_vertex_angles.h"
+
+#include <Define.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+using namespace thrive;
+// ------------------------------------ //
+void
+    MembraneVertexAngles::build(const std::vector<Float2>& vertices)
+{
+    m_sorted.clear();
+    m_sorted.reserve(vertices.size());
+
+    for(size_t i = 0; i < vertices.size(); ++i) {
+        m_sorted.push_back({std::atan2(vertices[i].Y, vertices[i].X),
+            static_cast<uint32_t>(i), vertices[i]});
+    }
+
+    std::sort(m_sorted.begin(), m_sorted.end(),
+        [](const Entry& first, const Entry& second) {
+            if(first.angle != second.angle)
+                return first.angle < second.angle;
+
+            return first.index < second.index;
+        });
+}
+
+void
+    MembraneVertexAngles::clear()
+{
+    m_sorted.clear();
+}
+// ------------------------------------ //
+Float2
+    MembraneVertexAngles::findClosest(float angle) const
+{
+    const auto after = std::lower_bound(m_sorted.begin(), m_sorted.end(),
+        angle, [](const Entry& entry, float value) {
+            return entry.angle < value;
+        });
+
+    const auto differenceTo = [angle](const Entry& entry) {
+        return std::abs(entry.angle - angle);
+    };
+
+    // The differences only grow when moving away from angle so the closest is
+    // right before or after it
+    float closestDifference = Leviathan::PI * 2;
+
+    if(after != m_sorted.end())
+        closestDifference = std::min(closestDifference, differenceTo(*after));
+
+    if(after != m_sorted.begin()) {
+        closestDifference =
+            std::min(closestDifference, differenceTo(*std::prev(after)));
+    }
+
+    if(!(closestDifference < Leviathan::PI * 2))
+        return Float2(0, 0);
+
+    // Multiple vertices can be as close, either by having the same angle or
+    // due to rounding, and the one first in the membrane is used
+    const Entry* closest = nullptr;
+
+    const auto check = [&](const Entry& entry) {
+        if(differenceTo(entry) != closestDifference)
+            return false;
+
+        if(!closest || entry.index < closest->index)
+            closest = &entry;
+
+        return true;
+    };
+
+    for(auto iter = after; iter != m_sorted.end(); ++iter) {
+        if(!check(*iter))
+            break;
+    }
+
+    for(auto iter = after; iter != m_sorted.begin(); --iter) {
+        if(!check(*std::prev(iter)))
+            break;
+    }
+
+    return closest->vertex;
+}
@@ -0,0 +1,42 @@
+#pragma once
+// Thrive Game
+// Copyright (C) 2013-2019  Revolutionary Games
+// ------------------------------------ //
+#include <Common/Types.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace thrive {
+
+//! \brief The membrane vertices sorted by their angle around the cell center
+//!
+//! Built once when the membrane points change so that finding the vertex in
+//! some direction is a binary search instead of an atan2 for every vertex
+class MembraneVertexAngles {
+public:
+    void
+        build(const std::vector<Float2>& vertices);
+
+    void
+        clear();
+
+    //! \returns The vertex with the angle closest to angle. Ties go to the
+    //! vertex that is first in the membrane. Zero if there are no vertices
+    //! \note The angles don't wrap around, so this gives the same vertex as
+    //! the old loop that compared the atan2 of each vertex
+    Float2
+        findClosest(float angle) const;
+
+private:
+    struct Entry {
+        float angle;
+        uint32_t index;
+        Float2 vertex;
+    };
+
+    //! Sorted by angle and then by index
+    std::vector<Entry> m_sorted;
+};
+
+} // namespace thrive
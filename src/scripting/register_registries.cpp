@@ -167,6 +167,21 @@ bool
         ANGELSCRIPT_REGISTERFAIL;
     }
 
+    if(engine->RegisterObjectProperty("Compound", "bool implicitDiffusion",
+           asOFFSET(Compound, implicitDiffusion)) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectProperty("Compound", "float diffusionRate",
+           asOFFSET(Compound, diffusionRate)) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectProperty(
+           "Compound", "float viscosity", asOFFSET(Compound, viscosity)) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
     if(engine->RegisterObjectProperty(
            "Compound", "Float4 colour", asOFFSET(Compound, colour)) < 0) {
         ANGELSCRIPT_REGISTERFAIL;
@@ -7,6 +7,7 @@
 #include "microbe_stage/player_microbe_control.h"
 
 #include <Script/Bindings/BindHelpers.h>
+#include <Script/ScriptConversionHelpers.h>
 #include <Script/ScriptExecutor.h>
 
 #include <boost/scope_exit.hpp>
@@ -145,6 +146,104 @@ std::string
 
     return self.computeEnergyBalance(convertedOrganelles, patch->getBiome());
 }
+
+//! \brief Converts the parallel arrays received from scripts for the batched
+//! cloud methods
+//! \returns False if the arrays were invalid, the script exception has
+//! already been set then
+template<class OperationT>
+bool
+    convertScriptCloudOperations(const CScriptArray* compounds,
+        const CScriptArray* values,
+        const CScriptArray* positions,
+        std::vector<OperationT>& result)
+{
+    if(!compounds || !values || !positions) {
+        asGetActiveContext()->SetException("arrays may not be null");
+        return false;
+    }
+
+    static const auto float3Id =
+        Leviathan::AngelScriptTypeIDResolver<Float3>::Get(
+            Leviathan::ScriptExecutor::Get());
+
+    if(compounds->GetElementTypeId() != asTYPEID_UINT16 ||
+        values->GetElementTypeId() != asTYPEID_FLOAT ||
+        positions->GetElementTypeId() != float3Id) {
+        asGetActiveContext()->SetException("cloud array type mismatch");
+        return false;
+    }
+
+    if(compounds->GetSize() != values->GetSize() ||
+        compounds->GetSize() != positions->GetSize()) {
+        asGetActiveContext()->SetException(
+            "cloud arrays need to be the same size");
+        return false;
+    }
+
+    result.reserve(compounds->GetSize());
+
+    for(asUINT i = 0; i < compounds->GetSize(); ++i) {
+        result.push_back(
+            OperationT{*static_cast<const CompoundId*>(compounds->At(i)),
+                *static_cast<const float*>(values->At(i)),
+                *static_cast<const Float3*>(positions->At(i))});
+    }
+
+    return true;
+}
+
+uint32_t
+    addCloudsWrapper(CompoundCloudSystem& self,
+        const CScriptArray* compounds,
+        const CScriptArray* amounts,
+        const CScriptArray* positions)
+{
+    BOOST_SCOPE_EXIT(&compounds, &amounts, &positions)
+    {
+        if(compounds)
+            compounds->Release();
+        if(amounts)
+            amounts->Release();
+        if(positions)
+            positions->Release();
+    }
+    BOOST_SCOPE_EXIT_END;
+
+    std::vector<CloudDeposit> deposits;
+    if(!convertScriptCloudOperations(compounds, amounts, positions, deposits))
+        return 0;
+
+    return static_cast<uint32_t>(self.addClouds(deposits));
+}
+
+CScriptArray*
+    takeCompoundsWrapper(CompoundCloudSystem& self,
+        const CScriptArray* compounds,
+        const CScriptArray* rates,
+        const CScriptArray* positions)
+{
+    BOOST_SCOPE_EXIT(&compounds, &rates, &positions)
+    {
+        if(compounds)
+            compounds->Release();
+        if(rates)
+            rates->Release();
+        if(positions)
+            positions->Release();
+    }
+    BOOST_SCOPE_EXIT_END;
+
+    std::vector<CloudTake> takes;
+    if(!convertScriptCloudOperations(compounds, rates, positions, takes))
+        return nullptr;
+
+    std::vector<float> taken;
+    self.takeCompounds(takes, taken);
+
+    return Leviathan::ConvertVectorToASArray(taken,
+        Leviathan::ScriptExecutor::Get()->GetASEngine(), "array<float>");
+}
 // ------------------------------------ //
 class WorldEffectScript : public WorldEffect {
 public:
@@ -274,16 +373,66 @@ bool
     }
 
     if(engine->RegisterObjectMethod("CompoundCloudSystem",
-           "int takeCompound(CompoundId compound, const Float3 &in "
+           "float takeCompound(CompoundId compound, const Float3 &in "
            "worldPosition, float rate)",
            asMETHOD(CompoundCloudSystem, takeCompound), asCALL_THISCALL) < 0) {
         ANGELSCRIPT_REGISTERFAIL;
     }
 
     if(engine->RegisterObjectMethod("CompoundCloudSystem",
-           "int amountAvailable(CompoundId compound, const Float3 &in "
+           "float amountAvailable(CompoundId compound, const Float3 &in "
            "worldPosition, float rate)",
-           asMETHOD(CompoundCloudSystem, takeCompound), asCALL_THISCALL) < 0) {
+           asMETHOD(CompoundCloudSystem, amountAvailable),
+           asCALL_THISCALL) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectMethod("CompoundCloudSystem",
+           "uint addClouds(const array<CompoundId>@ compounds, "
+           "const array<float>@ amounts, const array<Float3>@ positions)",
+           asFUNCTION(addCloudsWrapper), asCALL_CDECL_OBJFIRST) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectMethod("CompoundCloudSystem",
+           "array<float>@ takeCompounds(const array<CompoundId>@ compounds, "
+           "const array<float>@ rates, const array<Float3>@ positions)",
+           asFUNCTION(takeCompoundsWrapper), asCALL_CDECL_OBJFIRST) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectMethod("CompoundCloudSystem",
+           "uint64 getSkippedTextureUploads() const",
+           asMETHOD(CompoundCloudSystem, getSkippedTextureUploads),
+           asCALL_THISCALL) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectMethod("CompoundCloudSystem",
+           "uint64 getLateTextureUploads() const",
+           asMETHOD(CompoundCloudSystem, getLateTextureUploads),
+           asCALL_THISCALL) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectMethod("CompoundCloudSystem",
+           "void setSimulationRate(float stepsPerSecond)",
+           asMETHOD(CompoundCloudSystem, setSimulationRate),
+           asCALL_THISCALL) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectMethod("CompoundCloudSystem",
+           "float getSimulationRate() const",
+           asMETHOD(CompoundCloudSystem, getSimulationRate),
+           asCALL_THISCALL) < 0) {
+        ANGELSCRIPT_REGISTERFAIL;
+    }
+
+    if(engine->RegisterObjectMethod("CompoundCloudSystem",
+           "uint64 getDroppedSimulationSteps() const",
+           asMETHOD(CompoundCloudSystem, getDroppedSimulationSteps),
+           asCALL_THISCALL) < 0) {
         ANGELSCRIPT_REGISTERFAIL;
     }
 
@@ -152,6 +152,307 @@ TEST_CASE("Cloud local coordinate calculation math is right", "[microbe]")
     }
 }
 
+TEST_CASE("Cloud density storage channels don't overlap", "[microbe]")
+{
+    CloudDensityStorage storage;
+    storage.allocate(CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT);
+
+    REQUIRE(storage.isAllocated());
+    CHECK(reinterpret_cast<uintptr_t>(storage.getDensity(0).data()) %
+              CLOUD_DENSITY_ALIGNMENT ==
+          0);
+
+    for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
+        storage.getDensity(i)(CLOUD_SIMULATION_WIDTH - 1, 5) = 1.f + i;
+        storage.getOldDensity(i)(0, CLOUD_SIMULATION_HEIGHT - 1) = 10.f + i;
+    }
+
+    for(size_t i = 0; i < CLOUDS_IN_ONE; ++i) {
+        CHECK(storage.getDensity(i)(CLOUD_SIMULATION_WIDTH - 1, 5) == 1.f + i);
+        CHECK(storage.getOldDensity(i)(0, CLOUD_SIMULATION_HEIGHT - 1) ==
+              10.f + i);
+        CHECK(storage.getDensity(i).row(5)[(CLOUD_SIMULATION_WIDTH - 1) *
+                                           CloudDensityView::ELEMENT_STRIDE] ==
+              1.f + i);
+    }
+
+    storage.getDensity(2).clear();
+    CHECK(storage.getDensity(2)(CLOUD_SIMULATION_WIDTH - 1, 5) == 0);
+    CHECK(storage.getDensity(3)(CLOUD_SIMULATION_WIDTH - 1, 5) == 4.f);
+
+    storage.clear();
+    for(size_t i = 0; i < CLOUDS_IN_ONE; ++i)
+        CHECK(storage.getOldDensity(i)(0, CLOUD_SIMULATION_HEIGHT - 1) == 0);
+}
+
+TEST_CASE("Half cloud densities stay within the error bound", "[microbe]")
+{
+    const float value = GENERATE(0.02f, 1.f, 3.3f, 1000.f, 12345.6f, 6e5f);
+
+    const float stored = CloudDensityHalf(value);
+    CHECK(stored == Approx(value).epsilon(1.f / 2048));
+
+    CHECK(static_cast<float>(CloudDensityHalf(0.f)) == 0);
+    CHECK(static_cast<float>(CloudDensityHalf(
+              CloudDensityHalf::MIN_VALUE / 2)) == 0);
+    CHECK(static_cast<float>(CloudDensityHalf(1e9f)) ==
+          CloudDensityHalf::MAX_VALUE);
+
+    // Repeatedly moving small amounts between cells doesn't drift more than
+    // the bound of a single value
+    CloudDensityHalf first(value);
+    CloudDensityHalf second(value);
+    const float total = static_cast<float>(first) + second;
+
+    for(int i = 0; i < 1000; ++i) {
+        const float moved = first * 0.01f;
+        first -= moved;
+        second += moved;
+
+        const float back = second * 0.01f;
+        second -= back;
+        first += back;
+    }
+
+    CHECK(static_cast<float>(first) + second ==
+          Approx(total).epsilon(1.f / 2048));
+}
+
+TEST_CASE("Vector cloud kernels match the scalar ones", "[microbe]")
+{
+    const auto isa = GENERATE(CLOUD_KERNEL_ISA::SSE2, CLOUD_KERNEL_ISA::AVX2);
+
+    if(!CloudSimulationKernels::isSupported(isa))
+        return;
+
+    CloudSimulationKernels scalar(CLOUD_KERNEL_ISA::SCALAR);
+    CloudSimulationKernels vector(isa);
+
+    CloudDensityStorage scalarData;
+    CloudDensityStorage vectorData;
+    scalarData.allocate(CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT);
+    vectorData.allocate(CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT);
+
+    // Deterministic pattern with empty cells and a couple of hot spots
+    for(size_t y = 0; y < CLOUD_SIMULATION_HEIGHT; ++y) {
+        for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH; ++x) {
+            const float value = (x * 7 + y * 13) % 5 == 0 ? 0 : (x * y) % 977;
+            scalarData.getDensity(0)(x, y) = value;
+            vectorData.getDensity(0)(x, y) = value;
+        }
+    }
+
+    std::vector<float> velocityX(CLOUD_SIMULATION_WIDTH);
+    std::vector<float> velocityY(CLOUD_SIMULATION_WIDTH);
+
+    for(int step = 0; step < 5; ++step) {
+
+        scalar.diffuse(0.007f, scalarData.getOldDensity(0),
+            scalarData.getDensity(0), 1.6f);
+        vector.diffuse(0.007f, vectorData.getOldDensity(0),
+            vectorData.getDensity(0), 1.6f);
+
+        scalarData.getDensity(0).clear();
+        vectorData.getDensity(0).clear();
+
+        for(size_t y = 1; y < CLOUD_SIMULATION_HEIGHT - 1; ++y) {
+
+            for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH; ++x) {
+                velocityX[x] = std::sin(x * 0.3f + y) * 3;
+                velocityY[x] = std::cos(x * 0.1f * y) * 3;
+            }
+
+            scalar.advectRow(scalarData.getOldDensity(0),
+                scalarData.getDensity(0), y, 1, CLOUD_SIMULATION_WIDTH - 1,
+                1.6f, velocityX.data(), velocityY.data());
+            vector.advectRow(vectorData.getOldDensity(0),
+                vectorData.getDensity(0), y, 1, CLOUD_SIMULATION_WIDTH - 1,
+                1.6f, velocityX.data(), velocityY.data());
+        }
+    }
+
+    for(size_t y = 0; y < CLOUD_SIMULATION_HEIGHT; ++y) {
+        for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH; ++x) {
+            CAPTURE(x, y);
+            CHECK(vectorData.getDensity(0)(x, y) ==
+                  Approx(scalarData.getDensity(0)(x, y)).margin(0.01));
+        }
+    }
+}
+
+TEST_CASE("Diffusing only the active region matches the full grid",
+    "[microbe]")
+{
+    CloudSimulationKernels kernels;
+
+    CloudDensityStorage full;
+    CloudDensityStorage limited;
+    full.allocate(CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT);
+    limited.allocate(CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT);
+
+    for(size_t y = 40; y < 50; ++y) {
+        for(size_t x = 20; x < 35; ++x) {
+            full.getDensity(0)(x, y) = 1000.f + x * y;
+            limited.getDensity(0)(x, y) = 1000.f + x * y;
+            limited.getActiveRegion(0).include(x, y);
+        }
+    }
+
+    REQUIRE(limited.getActiveRegion(0) == CloudRegion{20, 40, 35, 50});
+
+    for(int step = 0; step < 3; ++step) {
+
+        kernels.diffuse(
+            0.007f, full.getOldDensity(0), full.getDensity(0), 1.6f);
+
+        const auto area = limited.getActiveRegion(0).expanded(
+            1, CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT);
+        kernels.diffuse(0.007f, limited.getOldDensity(0),
+            limited.getDensity(0), 1.6f, area);
+
+        const auto occupied = CloudSimulationKernels::trimToOccupied(
+            limited.getOldDensity(0), area, CLOUD_EMPTY_THRESHOLD);
+
+        // The diffusion can't spread things far
+        CHECK(occupied.startX >= 20 - 3);
+        CHECK(occupied.endX <= 35 + 3);
+
+        limited.getActiveRegion(0) = occupied;
+    }
+
+    for(size_t y = 0; y < CLOUD_SIMULATION_HEIGHT; ++y) {
+        for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH; ++x) {
+            CAPTURE(x, y);
+            CHECK(limited.getOldDensity(0)(x, y) ==
+                  Approx(full.getOldDensity(0)(x, y)).margin(0.01));
+        }
+    }
+}
+
+TEST_CASE("Implicit cloud diffusion is stable with long timesteps",
+    "[microbe]")
+{
+    CloudSimulationKernels kernels;
+
+    CloudDensityStorage storage;
+    storage.allocate(CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT);
+
+    const CloudRegion area{30, 30, 70, 70};
+    storage.getDensity(0)(50, 50) = 10000.f;
+
+    // This is so long that the explicit version makes negative densities
+    const float dt = 1000.f;
+
+    kernels.diffuseImplicit(
+        0.007f, storage.getOldDensity(0), storage.getDensity(0), dt, area);
+
+    const auto result = storage.getOldDensity(0);
+
+    float total = 0;
+
+    for(size_t y = 0; y < CLOUD_SIMULATION_HEIGHT; ++y) {
+        for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH; ++x) {
+            CAPTURE(x, y);
+            CHECK(result(x, y) >= 0);
+            CHECK(result(x, y) <= 10000.f);
+            total += result(x, y);
+        }
+    }
+
+    // The center spreads to the neighbours
+    CHECK(result(50, 50) < 10000.f);
+    CHECK(result(51, 50) > 0);
+    CHECK(result(51, 50) == Approx(result(50, 51)));
+
+    // The iterations don't fully converge so this is approximate
+    CHECK(total == Approx(10000.f).epsilon(0.1));
+}
+
+TEST_CASE("Cloud tile cache restores stored clouds", "[microbe]")
+{
+    CloudDensityStorage storage;
+    storage.allocate(
+        CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT, CLOUD_HALO);
+
+    for(size_t y = 30; y < 60; ++y) {
+        for(size_t x = 10; x < 20; ++x) {
+            storage.getDensity(1)(x, y) = x < 15 ? 500.f : 12.5f * y;
+            storage.getActiveRegion(1).include(x + CLOUD_HALO, y + CLOUD_HALO);
+        }
+    }
+
+    const CloudTileKey key{2, -1, 5};
+
+    CloudTileCache cache;
+    cache.store(key, storage);
+
+    CHECK(cache.size() == 1);
+
+    const auto tileBytes = cache.getUsedBytes();
+
+    CloudDensityStorage restored;
+    restored.allocate(
+        CLOUD_SIMULATION_WIDTH, CLOUD_SIMULATION_HEIGHT, CLOUD_HALO);
+
+    CHECK(!cache.restore(CloudTileKey{2, -1, 6}, restored));
+    REQUIRE(cache.restore(key, restored));
+
+    CHECK(cache.size() == 0);
+    CHECK(cache.getUsedBytes() == 0);
+
+    CHECK(restored.getActiveRegion(0).isEmpty());
+    CHECK(restored.getActiveRegion(1) == storage.getActiveRegion(1));
+
+    for(size_t y = 0; y < CLOUD_SIMULATION_HEIGHT; ++y) {
+        for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH; ++x) {
+            CHECK(restored.getDensity(1)(x, y) ==
+                  Approx(storage.getDensity(1)(x, y)).margin(0.01));
+        }
+    }
+
+    SECTION("The oldest tiles are dropped when full")
+    {
+        CloudTileCache limited(tileBytes * 2 + tileBytes / 2);
+
+        limited.store({0, 0, 1}, storage);
+        limited.store({1, 0, 1}, storage);
+        limited.store({2, 0, 1}, storage);
+
+        CHECK(limited.size() == 2);
+        CHECK(limited.getUsedBytes() <= tileBytes * 2 + tileBytes / 2);
+
+        restored.clear();
+        CHECK(!limited.restore({0, 0, 1}, restored));
+        CHECK(limited.restore({2, 0, 1}, restored));
+    }
+}
+
+TEST_CASE("Batched fluid noise matches the single point noise", "[microbe]")
+{
+    PerlinNoise noise(69);
+
+    // Both a step that puts many points into one unit cube and one that
+    // crosses a cube boundary on almost every point
+    const float step = GENERATE(0.01f, 0.1f, 0.9f);
+
+    std::vector<float> row(301);
+
+    for(int y = 0; y < 20; ++y) {
+
+        const float worldY = -15 + y * 1.37f;
+        const float time = 12.5f + y * 0.2f;
+
+        noise.noiseRow(-15.03f, step, worldY, time, row.data(), row.size());
+
+        for(size_t x = 0; x < row.size(); ++x) {
+            CAPTURE(step, x, y);
+            CHECK(row[x] == Approx(noise.noise(-15.03f + x * step, worldY,
+                                       time))
+                                .margin(0.00001));
+        }
+    }
+}
+
 TEST_CASE("CloudManager grid center calculation", "[microbe]")
 {
     CHECK(CompoundCloudSystem::calculateGridCenterForPlayerPos(
@@ -185,6 +486,37 @@ TEST_CASE("CloudManager grid center calculation", "[microbe]")
               -CLOUD_WIDTH + 1, 0, -CLOUD_HEIGHT + 1)) == Float3(0, 0, 0));
 }
 
+namespace thrive { namespace test {
+//! \brief Gives the tests access to the simulation state of the clouds
+class TestCompoundCloudSystem {
+public:
+    //! \returns The number of cloud channels simulated on the last step
+    static size_t
+        getSimulatedChannelCount(const CompoundCloudSystem& system)
+    {
+        return system.m_simulationWork.size();
+    }
+
+    static void
+        scheduleGroupSteps(CompoundCloudSystem& system, float elapsed)
+    {
+        system.scheduleGroupSteps(elapsed);
+    }
+
+    static const std::vector<size_t>&
+        getSteppedGroups(const CompoundCloudSystem& system)
+    {
+        return system.m_steppedGroups;
+    }
+
+    static const std::vector<float>&
+        getGroupTimeAccumulators(const CompoundCloudSystem& system)
+    {
+        return system.m_groupTimeAccumulators;
+    }
+};
+}} // namespace thrive::test
+
 class CloudManagerTestsFixture {
 public:
     CloudManagerTestsFixture()
@@ -623,3 +955,261 @@ TEST_CASE_METHOD(CloudManagerTestsFixture,
     CHECK(cloudGroup2AtOrigin->amountAvailable(5, std::get<0>(centerCoords),
               std::get<1>(centerCoords), 1) == 15);
 }
+
+TEST_CASE_METHOD(CloudManagerTestsFixture,
+    "Cloud manager finds the right cloud after moving with 5 compound types",
+    "[microbe]")
+{
+    const std::vector<Compound> types{
+        Compound{1, "a", true, true, false, Float4(0, 1, 2, 1)},
+        Compound{2, "b", true, true, false, Float4(3, 4, 5, 1)},
+        Compound{3, "c", true, true, false, Float4(6, 7, 8, 1)},
+        Compound{4, "d", true, true, false, Float4(9, 10, 11, 1)},
+        Compound{5, "e", true, true, false, Float4(12, 13, 14, 1)}};
+
+    setCloudsAndRunInitial(types);
+
+    movePlayerXUnits(1000);
+
+    auto& system = world.GetCompoundCloudSystem();
+
+    const auto gridPositions = CompoundCloudSystem::calculateGridPositions(
+        CompoundCloudSystem::calculateGridCenterForPlayerPos(
+            playerPos->Members._Position));
+
+    for(const auto& gridPos : gridPositions) {
+
+        // Near a corner to also check the edges
+        const auto pos = gridPos + Float3(-CLOUD_WIDTH + 1, 0, 15);
+        CAPTURE(pos);
+
+        CHECK(system.addCloud(2, 20, pos));
+        CHECK(system.addCloud(5, 30, pos));
+
+        CHECK(system.amountAvailable(2, pos, 1) == 20);
+        CHECK(system.amountAvailable(5, pos, 1) == 30);
+        CHECK(system.amountAvailable(1, pos, 1) == 0);
+        CHECK(system.getAllAvailableAt(pos).size() == 2);
+    }
+
+    // Outside the loaded clouds
+    CHECK(!system.addCloud(2, 20, Float3(0, 0, 0)));
+    CHECK(system.amountAvailable(2, Float3(0, 0, 0), 1) == 0);
+
+    // Not a cloud type
+    CHECK(!system.addCloud(6, 20, gridPositions[0]));
+}
+
+TEST_CASE_METHOD(CloudManagerTestsFixture,
+    "Batched cloud operations match the single ones", "[microbe]")
+{
+    setCloudsAndRunInitial(
+        {Compound{1, "a", true, true, false, Float4(0, 1, 2, 3)},
+            Compound{2, "b", true, true, false, Float4(3, 4, 5, 1)}});
+
+    auto& system = world.GetCompoundCloudSystem();
+
+    const Float3 first(10, 0, 10);
+    const Float3 second(-150, 0, 120);
+    const Float3 outside(5000, 0, 0);
+
+    CHECK(system.addClouds({{1, 10, first}, {2, 20, second}, {1, 5, first},
+              {1, 100, outside}}) == 3);
+
+    CHECK(system.amountAvailable(1, first, 1) == 15);
+    CHECK(system.amountAvailable(2, second, 1) == 20);
+
+    std::vector<float> taken;
+    system.takeCompounds(
+        {{1, 0.5f, first}, {1, 1, outside}, {2, 1, second}, {1, 1, first}},
+        taken);
+
+    REQUIRE(taken.size() == 4);
+    CHECK(taken[0] == 7);
+    CHECK(taken[1] == 0);
+    CHECK(taken[2] == 20);
+    CHECK(taken[3] == 8);
+}
+
+TEST_CASE_METHOD(CloudManagerTestsFixture,
+    "Cloud groups are stepped on different ticks", "[microbe]")
+{
+    // Two groups
+    world.GetCompoundCloudSystem().registerCloudTypes(world,
+        {Compound{1, "a", true, true, false, Float4(0, 1, 2, 1)},
+            Compound{2, "b", true, true, false, Float4(3, 4, 5, 1)},
+            Compound{3, "c", true, true, false, Float4(6, 7, 8, 1)},
+            Compound{4, "d", true, true, false, Float4(9, 10, 11, 1)},
+            Compound{5, "e", true, true, false, Float4(12, 13, 14, 1)}});
+
+    auto& system = world.GetCompoundCloudSystem();
+    const float interval = 1 / system.getSimulationRate();
+
+    const auto& stepped = TestCompoundCloudSystem::getSteppedGroups(system);
+    const auto& accumulators =
+        TestCompoundCloudSystem::getGroupTimeAccumulators(system);
+
+    // The second group starts half a step ahead
+    TestCompoundCloudSystem::scheduleGroupSteps(system, interval / 4);
+    REQUIRE(accumulators.size() == 2);
+    CHECK(accumulators[0] == Approx(interval / 4));
+    CHECK(accumulators[1] == Approx(interval * 3 / 4));
+    CHECK(stepped.empty());
+
+    TestCompoundCloudSystem::scheduleGroupSteps(system, interval / 2);
+    CHECK(stepped == std::vector<size_t>{1});
+
+    TestCompoundCloudSystem::scheduleGroupSteps(system, interval / 2);
+    CHECK(stepped == std::vector<size_t>{0});
+
+    CHECK(system.getDroppedSimulationSteps() == 0);
+
+    // Only one step per tick. The second group falls behind enough that the
+    // extra step is dropped
+    TestCompoundCloudSystem::scheduleGroupSteps(system, interval * 1.5f);
+    CHECK(stepped == std::vector<size_t>{0, 1});
+    CHECK(accumulators[0] == Approx(interval * 3 / 4));
+    CHECK(accumulators[1] == Approx(interval / 4));
+    CHECK(system.getDroppedSimulationSteps() == 1);
+
+    // A long lag drops everything but the one step and what is left over
+    // from it
+    TestCompoundCloudSystem::scheduleGroupSteps(system, interval * 10);
+    CHECK(stepped == std::vector<size_t>{0, 1});
+    CHECK(accumulators[0] == Approx(interval * 3 / 4));
+    CHECK(accumulators[1] == Approx(interval / 4));
+    CHECK(system.getDroppedSimulationSteps() == 19);
+}
+
+//! \brief Adds amount of compound to every cell of all the clouds
+void
+    fillCloudGrid(CompoundCloudSystem& system,
+        CompoundId compound,
+        float amount)
+{
+    std::vector<CloudDeposit> deposits;
+
+    // The centers of the cells of the grid around the origin
+    const float left = -CLOUD_WIDTH - CLOUD_X_EXTENT + CLOUD_RESOLUTION / 2.f;
+    const float top = -CLOUD_HEIGHT - CLOUD_Y_EXTENT + CLOUD_RESOLUTION / 2.f;
+
+    for(size_t y = 0; y < CLOUD_SIMULATION_HEIGHT * 3; ++y) {
+        for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH * 3; ++x) {
+            deposits.push_back({compound, amount,
+                Float3(left + static_cast<float>(x * CLOUD_RESOLUTION), 0,
+                    top + static_cast<float>(y * CLOUD_RESOLUTION))});
+        }
+    }
+
+    REQUIRE(system.addClouds(deposits) == deposits.size());
+}
+
+//! \returns The total amount of compounds in the clouds
+double
+    sumClouds(const std::vector<CompoundCloudComponent*>& clouds)
+{
+    double total = 0;
+
+    for(auto* cloud : clouds) {
+
+        std::vector<std::tuple<CompoundId, float>> found;
+
+        for(size_t y = 0; y < CLOUD_SIMULATION_HEIGHT; ++y)
+            for(size_t x = 0; x < CLOUD_SIMULATION_WIDTH; ++x)
+                cloud->getCompoundsAt(x, y, found);
+
+        for(const auto& entry : found)
+            total += std::get<1>(entry);
+    }
+
+    return total;
+}
+
+TEST_CASE_METHOD(CloudManagerTestsFixture,
+    "Compounds move across cloud edges without disappearing", "[microbe]")
+{
+    setCloudsAndRunInitial(
+        {Compound{1, "a", true, true, false, Float4(0, 1, 2, 3)}});
+
+    auto& system = world.GetCompoundCloudSystem();
+
+    // Advect drops the cells with too little to move. This is enough that no
+    // cell empties out where the flow spreads things apart
+    fillCloudGrid(system, 1, 50);
+
+    // On the last column of the middle cloud
+    REQUIRE(system.addCloud(1, 10000, Float3(CLOUD_WIDTH - 1, 0, 0)));
+
+    for(int i = 0; i < 20; ++i)
+        world.Tick(1);
+
+    // Part of it has diffused to the first column of the right cloud
+    CHECK(system.amountAvailable(1, Float3(CLOUD_WIDTH + 1, 0, 0), 1) > 60);
+
+    // Only float rounding changes the total. Losing or doubling even one
+    // cell of the edge would be more than this
+    const double expected =
+        10000 + 50.0 * CLOUD_SIMULATION_WIDTH * CLOUD_SIMULATION_HEIGHT * 9;
+
+    CHECK(sumClouds(findClouds()) == Approx(expected).margin(5));
+}
+
+TEST_CASE_METHOD(CloudManagerTestsFixture,
+    "Emptied cloud channels stop being simulated", "[microbe]")
+{
+    setCloudsAndRunInitial(
+        {Compound{1, "a", true, true, false, Float4(0, 1, 2, 3)}});
+
+    auto& system = world.GetCompoundCloudSystem();
+
+    // One step of the cloud group on each run
+    const float step = 1 / system.getSimulationRate();
+
+    // Too little to be moved so advect drops this. The step after that finds
+    // the channel empty
+    REQUIRE(system.addCloud(1, 0.5f, Float3(0, 0, 0)));
+
+    for(int i = 0; i < 2; ++i) {
+        system.Run(world, step);
+        CHECK(TestCompoundCloudSystem::getSimulatedChannelCount(system) == 1);
+    }
+
+    // Neither the channel nor its neighbours have anything to simulate after
+    // that
+    for(int i = 0; i < 2; ++i) {
+        system.Run(world, step);
+        CHECK(TestCompoundCloudSystem::getSimulatedChannelCount(system) == 0);
+    }
+}
+
+TEST_CASE_METHOD(CloudManagerTestsFixture,
+    "Compounds in the low resolution clouds don't disappear", "[microbe]")
+{
+    setCloudsAndRunInitial(
+        {Compound{1, "a", true, true, false, Float4(0, 1, 2, 3)}});
+
+    auto& system = world.GetCompoundCloudSystem();
+
+    // Nothing is dropped by advect, see the edge test above
+    fillCloudGrid(system, 1, 50);
+
+    // The middle of the right cloud, which is simulated at a lower resolution
+    const Float3 start(CLOUD_X_EXTENT, 0, 0);
+    REQUIRE(system.addCloud(1, 10000, start));
+
+    for(int i = 0; i < 20; ++i)
+        world.Tick(1);
+
+    // Spread to the next block from the one block it was added to
+    CHECK(system.amountAvailable(1, start, 1) < 10000);
+    CHECK(system.amountAvailable(1,
+              start + Float3(CLOUD_RESOLUTION * CLOUD_EDGE_LOD_FACTOR, 0, 0),
+              1) > 100);
+
+    // The edges between the clouds of different resolutions don't change the
+    // total either
+    const double expected =
+        10000 + 50.0 * CLOUD_SIMULATION_WIDTH * CLOUD_SIMULATION_HEIGHT * 9;
+
+    CHECK(sumClouds(findClouds()) == Approx(expected).margin(5));
+}
@@ -0,0 +1,222 @@
+//! Tests membrane generation parts that don't need graphics
+#include "microbe_stage/membrane_generator.h"
+#include "microbe_stage/membrane_shape_cache.h"
+#include "microbe_stage/membrane_vertex_angles.h"
+
+#include "catch.hpp"
+
+using namespace thrive;
+
+TEST_CASE("Membrane shapes are shared until the last user is gone",
+    "[microbe]")
+{
+    MembraneShapeCache cache;
+
+    const MembraneShapeKey key{
+        MEMBRANE_TYPE::MEMBRANE, 10, 10, {Float2(0, 0), Float2(1, 2)}};
+
+    CHECK(!cache.find(key));
+
+    auto first = cache.insert(key, {Float2(1, 1), Float2(2, 2)});
+    REQUIRE(first);
+
+    auto second = cache.find(key);
+    CHECK(second == first);
+    CHECK(second->vertices2D.size() == 2);
+
+    // A shape generated at the same time doesn't replace the stored one
+    CHECK(cache.insert(key, {Float2(3, 3)}) == first);
+
+    // Any difference in what the generation depends on is a different shape
+    auto otherType = key;
+    otherType.type = MEMBRANE_TYPE::WALL;
+    CHECK(!cache.find(otherType));
+
+    auto otherOrganelles = key;
+    otherOrganelles.organellePositions.emplace_back(2, 2);
+    CHECK(!cache.find(otherOrganelles));
+
+    CHECK(cache.size() == 1);
+
+    first.reset();
+    CHECK(cache.find(key));
+
+    second.reset();
+    CHECK(!cache.find(key));
+    CHECK(cache.size() == 0);
+}
+
+TEST_CASE("Membrane placeholder surrounds the organelles", "[microbe]")
+{
+    const MembraneShapeKey key{MEMBRANE_TYPE::MEMBRANE, 10, 10,
+        {Float2(0, 0), Float2(3, -1), Float2(-2, 2)}};
+
+    const auto placeholder = MembraneGenerator::generatePlaceholder(key);
+
+    REQUIRE(placeholder.size() == 40);
+
+    for(const auto& point : placeholder) {
+        for(const auto& organelle : key.organellePositions)
+            CHECK(point.Length() > organelle.Length());
+    }
+
+    // The real membrane is about the same size so the radius doesn't jump
+    // when it replaces the placeholder
+    const auto generated = MembraneGenerator(key).generate();
+
+    float radius = 0;
+    for(const auto& point : generated)
+        radius = std::max(radius, point.Length());
+
+    CHECK(radius == Approx(placeholder[0].Length()).epsilon(0.1));
+}
+
+TEST_CASE("Membrane organelle lookup finds the same organelles as a linear "
+          "search",
+    "[microbe]")
+{
+    MembraneShapeKey key{MEMBRANE_TYPE::MEMBRANE, 10, 10, {}};
+
+    // Includes duplicates to check that ties go to the first one
+    for(int i = 0; i < 50; ++i)
+        key.organellePositions.emplace_back((i * 7) % 13 - 6, (i * 5) % 11 - 5);
+
+    const MembraneGenerator generator(key);
+
+    for(float y = -10; y < 10; y += 0.37f) {
+        for(float x = -10; x < 10; x += 0.41f) {
+
+            const Float2 target(x, y);
+
+            Float2 expected(-999999.f, -999999.f);
+            float closest = 4;
+
+            for(const auto& pos : key.organellePositions) {
+                if((target - pos).LengthSquared() < closest) {
+                    closest = (target - pos).LengthSquared();
+                    expected = pos;
+                }
+            }
+
+            CHECK(generator.FindClosestOrganelles(target) == expected);
+        }
+    }
+}
+
+TEST_CASE("Membrane generation output hasn't changed", "[microbe]")
+{
+    // A small cell with organelles on all sides of the center
+    MembraneShapeKey key{MEMBRANE_TYPE::MEMBRANE, 10, 10,
+        {Float2(0, 0), Float2(1.5f, 0.75f), Float2(-1.5f, 0.75f),
+            Float2(0, -1.5f), Float2(3, 0), Float2(1.5f, -2.25f)}};
+
+    // Generated before the relaxation steps were changed to not reallocate
+    const std::vector<Float2> expectedMembrane{
+        {-2.483007f, -1.248350f}, {-2.795552f, -0.793299f},
+        {-3.093808f, -0.311858f}, {-3.339558f, 0.218099f},
+        {-3.461008f, 0.834932f}, {-3.209781f, 1.420640f},
+        {-3.014394f, 2.028209f}, {-2.520295f, 2.407415f},
+        {-1.994681f, 2.616476f}, {-1.483070f, 2.660042f},
+        {-0.980497f, 2.739390f}, {-0.462426f, 2.727368f},
+        {0.056470f, 2.701979f}, {0.570659f, 2.725204f},
+        {1.096400f, 2.733588f}, {1.606819f, 2.649228f},
+        {2.137345f, 2.598814f}, {2.622751f, 2.373342f},
+        {3.092190f, 2.138258f}, {3.590194f, 1.925590f},
+        {3.983671f, 1.558669f}, {4.410644f, 1.207642f},
+        {4.773544f, 0.725489f}, {5.025255f, 0.121222f},
+        {4.898327f, -0.528000f}, {4.613994f, -1.045783f},
+        {4.297009f, -1.525470f}, {4.009781f, -2.014484f},
+        {3.675388f, -2.496840f}, {3.374739f, -2.983327f},
+        {3.064790f, -3.484754f}, {2.610407f, -3.937851f},
+        {1.978911f, -4.085660f}, {1.400836f, -4.055120f},
+        {0.819529f, -4.084393f}, {0.306509f, -3.851717f},
+        {-0.167558f, -3.578547f}, {-0.671839f, -3.361490f},
+        {-1.169760f, -3.087372f}, {-1.525100f, -2.637291f},
+        {-1.907136f, -2.221090f}, {-2.213640f, -1.742859f},
+    };
+
+    const std::vector<Float2> expectedWall{
+        {-2.192818f, -1.714214f}, {-2.499259f, -1.236882f},
+        {-2.805501f, -0.759722f}, {-3.109206f, -0.280781f},
+        {-3.323725f, 0.221968f}, {-3.413451f, 0.750959f},
+        {-3.366597f, 1.316737f}, {-3.021281f, 1.811250f},
+        {-2.665030f, 2.298502f}, {-2.125681f, 2.551356f},
+        {-1.588674f, 2.669874f}, {-1.061098f, 2.696326f},
+        {-0.544573f, 2.693831f}, {-0.027872f, 2.692097f},
+        {0.488933f, 2.691143f}, {1.005867f, 2.690959f},
+        {1.522840f, 2.691615f}, {2.036110f, 2.630879f},
+        {2.523003f, 2.434962f}, {2.993771f, 2.206305f},
+        {3.464961f, 1.978370f}, {3.936554f, 1.751159f},
+        {4.359544f, 1.359091f}, {4.640259f, 0.832958f},
+        {4.913115f, 0.303094f}, {4.825186f, -0.343277f},
+        {4.709692f, -0.982778f}, {4.337896f, -1.534592f},
+        {3.966801f, -2.086801f}, {3.596445f, -2.639425f},
+        {3.226797f, -3.192438f}, {2.829831f, -3.731344f},
+        {2.291512f, -4.072456f}, {1.749344f, -4.121254f},
+        {1.206170f, -4.165916f}, {0.687082f, -4.071680f},
+        {0.232118f, -3.827272f}, {-0.223164f, -3.583626f},
+        {-0.678754f, -3.340761f}, {-1.137941f, -3.046256f},
+        {-1.581030f, -2.670113f}, {-1.886984f, -2.192104f},
+    };
+
+    const auto check = [](const std::vector<Float2>& generated,
+                           const std::vector<Float2>& expected) {
+        REQUIRE(generated.size() == expected.size());
+
+        for(size_t i = 0; i < expected.size(); ++i) {
+            CHECK(generated[i].X == Approx(expected[i].X).margin(0.0001));
+            CHECK(generated[i].Y == Approx(expected[i].Y).margin(0.0001));
+        }
+    };
+
+    check(MembraneGenerator(key).generate(), expectedMembrane);
+
+    key.type = MEMBRANE_TYPE::WALL;
+    check(MembraneGenerator(key).generate(), expectedWall);
+}
+
+TEST_CASE("Membrane vertex angle lookup finds the same vertex as a linear "
+          "search",
+    "[microbe]")
+{
+    const MembraneShapeKey key{MEMBRANE_TYPE::MEMBRANE, 10, 10,
+        {Float2(0, 0), Float2(1.5f, 0.75f), Float2(-1.5f, 0.75f)}};
+
+    auto vertices = MembraneGenerator(key).generate();
+
+    // Same angles as existing vertices to check that ties go to the first one
+    vertices.push_back(vertices[5] * 2);
+    vertices.insert(vertices.begin(), vertices[10] * 0.5f);
+
+    MembraneVertexAngles angles;
+    CHECK(angles.findClosest(1) == Float2(0, 0));
+
+    angles.build(vertices);
+
+    std::vector<float> queries;
+
+    for(float angle = -4; angle < 4; angle += 0.01f)
+        queries.push_back(angle);
+
+    for(const auto& vertex : vertices)
+        queries.push_back(std::atan2(vertex.Y, vertex.X));
+
+    for(float angle : queries) {
+
+        Float2 expected(0, 0);
+        float angleToClosest = Leviathan::PI * 2;
+
+        for(const auto& vertex : vertices) {
+
+            const float difference =
+                std::abs(std::atan2(vertex.Y, vertex.X) - angle);
+
+            if(difference < angleToClosest) {
+                expected = vertex;
+                angleToClosest = difference;
+            }
+        }
+
+        CHECK(angles.findClosest(angle) == expected);
+    }
+}